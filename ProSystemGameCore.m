@@ -43,13 +43,11 @@
 @interface ProSystemGameCore () <OE7800SystemResponderClient>
 {
     uint32_t *_videoBuffer;
-    uint32_t _displayPalette[256];
     uint8_t  *_soundBuffer;
     uint8_t _inputState[17];
     int _videoWidth, _videoHeight;
     BOOL _isLightgunEnabled;
 }
-- (void)setPalette32;
 @end
 
 @implementation ProSystemGameCore
@@ -59,7 +57,13 @@
     if((self = [super init]))
     {
         _videoBuffer = (uint32_t *)malloc(320 * 292 * 4);
-        _soundBuffer = (uint8_t *)malloc(8192);
+        sound_SetFormat(SOUND_FORMAT_S16, false);
+        _soundBuffer = (uint8_t *)malloc(sound_GetBufferSize());
+
+        // Make each frame's audio on a thread of its own until sound_Store,
+        // and turn line RAM into pixels on another
+        sound_SetThreaded(true);
+        maria_SetThreaded(true);
     }
 
     return self;
@@ -67,6 +71,8 @@
 
 - (void)dealloc
 {
+    sound_SetThreaded(false);
+    maria_SetThreaded(false);
     free(_videoBuffer);
     free(_soundBuffer);
 }
@@ -113,7 +119,7 @@
         }
 
         //sound_SetSampleRate(48000);
-        [self setPalette32];
+        maria_SetOutput(_videoBuffer, 320 * 4, MARIA_FORMAT_XRGB8888);
 
         _isLightgunEnabled = (cartridge_controller[0] & CARTRIDGE_CONTROLLER_LIGHTGUN);
         // The light gun 'trigger' is a press on the 'up' button (0x3) and needs the bit toggled
@@ -137,25 +143,8 @@
     _videoWidth  = ((maria_displayArea.right - maria_displayArea.left) + 1);
     _videoHeight = ((maria_visibleArea.bottom - maria_visibleArea.top) + 1);
 
-    uint8_t *buffer = maria_surface + ((maria_visibleArea.top - maria_displayArea.top) * _videoWidth);
-    uint32_t *surface = (uint32_t *)_videoBuffer;
-    int pitch = 320;
-
-    for(int indexY = 0; indexY < _videoHeight; indexY++)
-    {
-        for(int indexX = 0; indexX < _videoWidth; indexX += 4)
-        {
-            surface[indexX + 0] = _displayPalette[buffer[indexX + 0]];
-            surface[indexX + 1] = _displayPalette[buffer[indexX + 1]];
-            surface[indexX + 2] = _displayPalette[buffer[indexX + 2]];
-            surface[indexX + 3] = _displayPalette[buffer[indexX + 3]];
-        }
-        surface += pitch;
-        buffer += _videoWidth;
-    }
-
     int length = sound_Store(_soundBuffer);
-    [[self audioBufferAtIndex:0] write:_soundBuffer maxLength:length];
+    [[self audioBufferAtIndex:0] write:_soundBuffer maxLength:length * sound_GetSampleSize()];
 }
 
 - (void)resetEmulation
@@ -172,7 +161,9 @@
 
 - (const void *)getVideoBufferWithHint:(void *)hint
 {
-    return _videoBuffer = (uint32_t*)(hint ?: _videoBuffer);
+    _videoBuffer = (uint32_t*)(hint ?: _videoBuffer);
+    maria_SetOutput(_videoBuffer, 320 * 4, MARIA_FORMAT_XRGB8888);
+    return _videoBuffer;
 }
 
 - (OEIntRect)screenRect
@@ -214,7 +205,7 @@
 
 - (NSUInteger)audioBitDepth
 {
-    return 8;
+    return 16;
 }
 
 #pragma mark - Save States
@@ -405,17 +396,4 @@ const int ProSystemMap[] = { 3, 2, 1, 0, 4, 5, 9, 8, 7, 6, 10, 11, 13, 14, 12, 1
         _inputState[3] = 1;
 }
 
-#pragma mark - Misc Helper Methods
-// Set palette 32bpp
-- (void)setPalette32
-{
-    for(int index = 0; index < 256; index++)
-    {
-        uint32_t r = palette_data[(index * 3) + 0] << 16;
-        uint32_t g = palette_data[(index * 3) + 1] << 8;
-        uint32_t b = palette_data[(index * 3) + 2];
-        _displayPalette[index] = r | g | b;
-    }
-}
-
 @end
@@ -29,12 +29,10 @@
 #include <stdbool.h>
 
 #include "Bios.h"
+#include "ProSystem.h"
 
-bool bios_enabled = false;
-char bios_filename[256];
-
-static uint8_t* bios_data = NULL;
-static uint16_t bios_size = 0;
+#define bios_data (prosystem_current->bios.data)
+#define bios_size (prosystem_current->bios.size)
 
 bool bios_Load(const char *filename) {
     bios_Release();
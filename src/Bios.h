@@ -28,11 +28,19 @@
 
 #include "Memory.h"
 
+typedef struct BiosState {
+    bool enabled;
+    char filename[256];
+    uint8_t* data;
+    uint16_t size;
+} bios_state;
+
 extern bool bios_Load(const char *filename);
 extern bool bios_IsLoaded(void);
 extern void bios_Store(void);
 extern void bios_Release(void);
-extern char bios_filename[256];
-extern bool bios_enabled;
+
+#define bios_filename (prosystem_current->bios.filename)
+#define bios_enabled (prosystem_current->bios.enabled)
 
 #endif
@@ -30,31 +30,10 @@
 #include <string.h>
 
 #include "Cartridge.h"
+#include "ProSystem.h"
 
-char cart_digest[33];
-
-const char *cartridge_filename;
-char cartridge_title[33];
-uint8_t cartridge_type;
-uint8_t cartridge_region;
-bool cartridge_pokey;
-bool cartridge_pokey450;
-uint8_t cartridge_controller[2];
-uint8_t cartridge_bank;
-uint32_t cartridge_flags;
-int cartridge_crosshair_x;
-int cartridge_crosshair_y;
-bool cartridge_dualanalog = false;
-bool cartridge_xm = false;
-bool cartridge_disable_bios = false;
-uint8_t cartridge_left_switch = 1;
-uint8_t cartridge_right_switch = 0;
-bool cartridge_swap_buttons = false;
-bool cartridge_hsc_enabled = false;
-uint32_t cartridge_hblank = HBLANK_DEFAULT;
-
-static uint8_t *cartridge_buffer = NULL;
-static size_t cartridge_size = 0;
+#define cartridge_buffer (prosystem_current->cartridge.buffer)
+#define cartridge_size (prosystem_current->cartridge.size)
 
 static bool cartridge_HasHeader(const uint8_t* header) {
     const char HEADER_ID[ ] = {"ATARI7800"};
@@ -100,6 +79,7 @@ static void cartridge_WriteBank(uint16_t address, uint8_t bank) {
     if (offset < cartridge_size) {
         memory_WriteROM(address, 16384, cartridge_buffer + offset);
         cartridge_bank = bank;
+        sally_Stop();
     }
 }
 
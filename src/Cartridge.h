@@ -47,36 +47,61 @@
 #include "md5.h"
 #include "Pokey.h"
 
+typedef struct CartridgeState {
+    char digest[33];
+    const char *filename;
+    char title[33];
+    uint8_t type;
+    uint8_t region;
+    bool pokey;
+    bool pokey450;
+    bool xm;
+    uint8_t controller[2];
+    uint8_t bank;
+    uint32_t flags;
+    bool disable_bios;
+    uint8_t left_switch;
+    uint8_t right_switch;
+    bool swap_buttons;
+    bool hsc_enabled;
+    // The x offset for the lightgun crosshair (allows per cartridge adjustments)
+    int crosshair_x;
+    // The y offset for the lightgun crosshair (allows per cartridge adjustments)
+    int crosshair_y;
+    // The hblank prior to DMA
+    uint32_t hblank;
+    // Whether the cartridge supports dual analog
+    bool dualanalog;
+    uint8_t *buffer;
+    uint32_t size;
+} cartridge_state;
+
 extern bool cartridge_Load(const uint8_t* data, uint32_t size);
 extern void cartridge_Store(void);
 extern void cartridge_StoreBank(uint8_t bank);
 extern void cartridge_Write(uint16_t address, uint8_t data);
 extern bool cartridge_IsLoaded(void);
 extern void cartridge_Release(void);
-extern char cart_digest[33];
-extern const char *cartridge_filename;
-extern char cartridge_title[33];
-extern uint8_t cartridge_type;
-extern uint8_t cartridge_region;
-extern bool cartridge_pokey;
-extern bool cartridge_pokey450;
-extern bool cartridge_xm;
-extern uint8_t cartridge_controller[2];
-extern uint8_t cartridge_bank;
-extern uint32_t cartridge_flags;
-extern bool cartridge_disable_bios;
-extern uint8_t cartridge_left_switch;
-extern uint8_t cartridge_right_switch;
-extern bool cartridge_swap_buttons;
-extern bool cartridge_hsc_enabled;
 
-// The x offset for the lightgun crosshair (allows per cartridge adjustments)
-extern int cartridge_crosshair_x;
-// The y offset for the lightgun crosshair (allows per cartridge adjustments)
-extern int cartridge_crosshair_y;
-// The hblank prior to DMA
-extern uint32_t cartridge_hblank;
-// Whether the cartridge supports dual analog
-extern bool cartridge_dualanalog;
+#define cart_digest (prosystem_current->cartridge.digest)
+#define cartridge_filename (prosystem_current->cartridge.filename)
+#define cartridge_title (prosystem_current->cartridge.title)
+#define cartridge_type (prosystem_current->cartridge.type)
+#define cartridge_region (prosystem_current->cartridge.region)
+#define cartridge_pokey (prosystem_current->cartridge.pokey)
+#define cartridge_pokey450 (prosystem_current->cartridge.pokey450)
+#define cartridge_xm (prosystem_current->cartridge.xm)
+#define cartridge_controller (prosystem_current->cartridge.controller)
+#define cartridge_bank (prosystem_current->cartridge.bank)
+#define cartridge_flags (prosystem_current->cartridge.flags)
+#define cartridge_disable_bios (prosystem_current->cartridge.disable_bios)
+#define cartridge_left_switch (prosystem_current->cartridge.left_switch)
+#define cartridge_right_switch (prosystem_current->cartridge.right_switch)
+#define cartridge_swap_buttons (prosystem_current->cartridge.swap_buttons)
+#define cartridge_hsc_enabled (prosystem_current->cartridge.hsc_enabled)
+#define cartridge_crosshair_x (prosystem_current->cartridge.crosshair_x)
+#define cartridge_crosshair_y (prosystem_current->cartridge.crosshair_y)
+#define cartridge_hblank (prosystem_current->cartridge.hblank)
+#define cartridge_dualanalog (prosystem_current->cartridge.dualanalog)
 
 #endif
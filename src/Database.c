@@ -30,10 +30,7 @@
 #include <string.h>
 
 #include "Database.h"
-
-bool cart_in_db = false;
-bool database_enabled = true;
-const char *database_filename;
+#include "ProSystem.h"
 
 bool database_Load(const char *digest) {
     cart_in_db = false;
@@ -28,9 +28,16 @@
 
 #include "Cartridge.h"
 
+typedef struct DatabaseState {
+    bool cartInDb;
+    bool enabled;
+    const char *filename;
+} database_state;
+
 extern bool database_Load(const char *digest);
-extern bool cart_in_db;
-extern bool database_enabled;
-extern const char *database_filename;
+
+#define cart_in_db (prosystem_current->database.cartInDb)
+#define database_enabled (prosystem_current->database.enabled)
+#define database_filename (prosystem_current->database.filename)
 
 #endif
@@ -29,12 +29,7 @@ if you wanted to. However since the PLD is soldered under the POKEY this needs t
 #include <stdbool.h>
 
 #include "ExpansionModule.h"
-
-uint8_t xm_ram[XM_RAM_SIZE] = {0};
-uint8_t xm_reg = 0;
-uint8_t xm_bank = 0;
-bool xm_pokey_enabled = false;
-bool xm_mem_enabled = false;
+#include "ProSystem.h"
 
 void xm_Reset(void) {
     for (int i = 0; i < XM_RAM_SIZE; i++) {
@@ -80,5 +75,6 @@ void xm_Write(uint16_t address, uint8_t data) {
         xm_bank = xm_reg & 7;
         xm_pokey_enabled = (xm_reg & 0x10) > 0;
         xm_mem_enabled = (xm_reg & 0x08) > 0;
+        memory_MapPages();
     } 
 }
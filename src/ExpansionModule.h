@@ -6,11 +6,19 @@
 
 #define XM_RAM_SIZE 0x20000
 
-extern uint8_t xm_ram[XM_RAM_SIZE];
-extern bool xm_pokey_enabled;
-extern bool xm_mem_enabled;
-extern uint8_t xm_reg;
-extern uint8_t xm_bank;
+typedef struct ExpansionModuleState {
+    uint8_t ram[XM_RAM_SIZE];
+    bool pokeyEnabled;
+    bool memEnabled;
+    uint8_t reg;
+    uint8_t bank;
+} xm_state;
+
+#define xm_ram (prosystem_current->xm.ram)
+#define xm_pokey_enabled (prosystem_current->xm.pokeyEnabled)
+#define xm_mem_enabled (prosystem_current->xm.memEnabled)
+#define xm_reg (prosystem_current->xm.reg)
+#define xm_bank (prosystem_current->xm.bank)
 
 void xm_Reset(void);
 uint8_t xm_Read(uint16_t address);
@@ -25,216 +25,1027 @@
 // ----------------------------------------------------------------------------
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(PROSYSTEM_NO_THREADS) && !defined(_WIN32)
+#define MARIA_THREADS
+#include <pthread.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// The indexed line expander is built for SSSE3 even where the compiler's
+// target is only SSE2, and used if the CPU turns out to have it
+#if defined(__SSSE3__)
+#define MARIA_SSSE3
+#define MARIA_SSSE3_TARGET
+#define MARIA_HAS_SSSE3() true
+#include <tmmintrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define MARIA_SSSE3
+#define MARIA_SSSE3_TARGET __attribute__((target("ssse3")))
+#define MARIA_HAS_SSSE3() __builtin_cpu_supports("ssse3")
+#include <tmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "Maria.h"
-#define MARIA_LINERAM_SIZE 160
-
-rect maria_displayArea = {0, 16, 319, 258};
-rect maria_visibleArea = {0, 26, 319, 248};
-uint8_t maria_surface[MARIA_SURFACE_SIZE] = {0};
-uint16_t maria_scanline = 1;
-
-static uint8_t maria_lineRAM[MARIA_LINERAM_SIZE];
-static uint32_t maria_cycles;
-static pair maria_dpp;
-static pair maria_dp;
-static pair maria_pp;
-static uint8_t maria_horizontal;
-static uint8_t maria_palette;
-static signed char maria_offset;
-static uint8_t maria_h08;
-static uint8_t maria_h16;
-static uint8_t maria_wmode;
-
-static inline void maria_StoreCell(uint8_t data) {
-    if (maria_horizontal < MARIA_LINERAM_SIZE) {
-        if (data) {
-            maria_lineRAM[maria_horizontal] = maria_palette | data;
+#include "ProSystem.h"
+
+#define maria_lineRAM (prosystem_current->maria.lineRAM)
+#define maria_cycles (prosystem_current->maria.cycles)
+#define maria_dpp (prosystem_current->maria.dpp)
+#define maria_dp (prosystem_current->maria.dp)
+#define maria_pp (prosystem_current->maria.pp)
+#define maria_horizontal (prosystem_current->maria.horizontal)
+#define maria_palette (prosystem_current->maria.palette)
+#define maria_offset (prosystem_current->maria.offset)
+#define maria_h08 (prosystem_current->maria.h08)
+#define maria_h16 (prosystem_current->maria.h16)
+#define maria_wmode (prosystem_current->maria.wmode)
+#define maria_output (prosystem_current->maria.output)
+#define maria_pitch (prosystem_current->maria.pitch)
+#define maria_format (prosystem_current->maria.format)
+#define maria_colors (prosystem_current->maria.colors)
+#define maria_narrow (prosystem_current->maria.narrow)
+#define maria_narrowLine (prosystem_current->maria.narrowLine)
+#define maria_skip (prosystem_current->maria.skip)
+#define maria_redraw (prosystem_current->maria.redraw)
+#define maria_objects (prosystem_current->maria.objects)
+#define maria_objectCount (prosystem_current->maria.objectCount)
+#define maria_zone (prosystem_current->maria.zone)
+#define maria_zoneValid (prosystem_current->maria.zoneValid)
+#define maria_zonePageCount (prosystem_current->maria.zonePageCount)
+#define maria_zonePage (prosystem_current->maria.zonePage)
+#define maria_zoneSerial (prosystem_current->maria.zoneSerial)
+#define maria_lines (prosystem_current->maria.lines)
+#define maria_lineStored (prosystem_current->maria.lineStored)
+#define maria_lineSame (prosystem_current->maria.lineSame)
+#define maria_lineFirst (prosystem_current->maria.lineFirst)
+#define maria_lineLast (prosystem_current->maria.lineLast)
+#define maria_thread (prosystem_current->maria.thread)
+
+// Frames a line that changed waits before it is memoized again
+#define MARIA_LINE_RETRY 8
+
+// maria_object mode bits
+#define MARIA_OBJECT_EXTENDED 1
+#define MARIA_OBJECT_INDIRECT 2
+#define MARIA_OBJECT_WMODE 4
+
+// Ways of drawing a line: in one color, from line RAM at one pixel per
+// entry, or from line RAM at two pixels per entry
+#define MARIA_JOB_FILL 0
+#define MARIA_JOB_COPY 1
+#define MARIA_JOB_EXPAND 2
+
+// Lines that can be queued for the worker at once, a power of two, and
+// lines handed to it at a time
+#define MARIA_JOB_COUNT 256
+#define MARIA_JOB_BATCH 16
+
+// Everything needed to draw one line without looking at the emulator. For
+// fills left[0] is the color; for copies left holds the color of each line
+// RAM value.
+typedef struct MariaJob {
+    uint8_t* line;
+    uint8_t kind;
+    uint8_t format;
+    uint16_t width;
+    uint8_t left[32];
+    uint8_t right[32];
+    uint8_t lineRAM[MARIA_LINERAM_SIZE];
+} maria_job;
+
+static inline bool maria_IsHolyDMA(uint16_t address) {
+    if (address > 32767) {
+        if (maria_h16 && (address & 4096)) {
+            return true;
         }
-        else {
-            uint8_t kmode = memory_ram[CTRL] & 4;
-            if (kmode) {
-                maria_lineRAM[maria_horizontal] = 0;
-            }
+        if (maria_h08 && (address & 2048)) {
+            return true;
         }
     }
-    maria_horizontal++;
+    return false;
 }
 
-static inline void maria_StoreCell2(uint8_t high, uint8_t low) {
-    if (maria_horizontal < MARIA_LINERAM_SIZE) {
-        if (low || high) {
-            maria_lineRAM[maria_horizontal] = (maria_palette & 16) | high | low;
+static inline uint8_t maria_GetColor(uint8_t data) {
+    if (data & 3) {
+        return memory_ram[BACKGRND + data];
+    }
+    else {
+        return memory_ram[BACKGRND];
+    }
+}
+
+// Stores the cells of one graphics byte from horizontal on and returns the
+// position after them. Line RAM spans every horizontal position, so cells
+// off the right of the screen land in its unused tail and need no check.
+static inline uint8_t maria_StoreGraphic(uint8_t* line, uint8_t horizontal, uint8_t data, uint8_t palette, bool wmode, bool kangaroo) {
+    if (wmode) {
+        uint8_t cells[2] = {(data & 12) | ((data & 192) >> 6), ((data & 48) >> 4) | ((data & 3) << 2)};
+        for (int cell = 0; cell < 2; cell++, horizontal++) {
+            if (cells[cell]) {
+                line[horizontal] = (palette & 16) | cells[cell];
+            }
+            else if (kangaroo) {
+                line[horizontal] = 0;
+            }
         }
-        else {
-            uint8_t kmode = memory_ram[CTRL] & 4;
-            if (kmode) {
-                maria_lineRAM[maria_horizontal] = 0;
+    }
+    else {
+        for (int shift = 6; shift >= 0; shift -= 2, horizontal++) {
+            uint8_t cell = (data >> shift) & 3;
+            if (cell) {
+                line[horizontal] = palette | cell;
+            }
+            else if (kangaroo) {
+                line[horizontal] = 0;
             }
         }
     }
-    maria_horizontal++;
+    return horizontal;
 }
 
-static inline bool maria_IsHolyDMA(void) {
-    if (maria_pp.w > 32767) {
-        if (maria_h16 && (maria_pp.w & 4096)) {
-            return true;
+// Graphics read from a hole in holey DMA come out as zero
+#define MARIA_FETCH(address, holey) (((holey) && maria_IsHolyDMA(address))? 0: memory_Peek(address))
+
+// Object renderers, one for each combination of write mode, kangaroo mode
+// and holey DMA, so that none of these are tested per cell. Direct objects
+// read width bytes from pp; indirect ones read width character numbers from
+// pp and then bytes graphics bytes for each from the character base.
+#define MARIA_OBJECT_RENDERERS(suffix, wmode, kangaroo, holey)                  \
+static void maria_StoreDirect##suffix(uint8_t width) {                          \
+    uint8_t* line = maria_lineRAM;                                              \
+    uint8_t horizontal = maria_horizontal;                                      \
+    uint8_t palette = maria_palette;                                            \
+    pair pp = maria_pp;                                                         \
+    for (int index = 0; index < width; index++, pp.w++) {                       \
+        horizontal = maria_StoreGraphic(line, horizontal, MARIA_FETCH(pp.w, holey), palette, wmode, kangaroo); \
+    }                                                                           \
+    maria_horizontal = horizontal;                                              \
+    maria_pp = pp;                                                              \
+}                                                                               \
+                                                                                \
+static void maria_StoreIndirect##suffix(uint8_t width, uint8_t bytes) {         \
+    uint8_t* line = maria_lineRAM;                                              \
+    uint8_t horizontal = maria_horizontal;                                      \
+    uint8_t palette = maria_palette;                                            \
+    uint8_t base = memory_ram[CHARBASE] + maria_offset;                         \
+    pair pp = maria_pp;                                                         \
+    pair graphic;                                                               \
+    for (int index = 0; index < width; index++, pp.w++) {                       \
+        graphic.b.l = memory_Peek(pp.w);                                        \
+        graphic.b.h = base;                                                     \
+        for (int byte = 0; byte < bytes; byte++, graphic.w++) {                 \
+            horizontal = maria_StoreGraphic(line, horizontal, MARIA_FETCH(graphic.w, holey), palette, wmode, kangaroo); \
+        }                                                                       \
+    }                                                                           \
+    maria_horizontal = horizontal;                                              \
+    maria_pp = graphic;                                                         \
+}
+
+MARIA_OBJECT_RENDERERS(0, false, false, false)
+MARIA_OBJECT_RENDERERS(1, false, false, true)
+MARIA_OBJECT_RENDERERS(2, false, true, false)
+MARIA_OBJECT_RENDERERS(3, false, true, true)
+MARIA_OBJECT_RENDERERS(4, true, false, false)
+MARIA_OBJECT_RENDERERS(5, true, false, true)
+MARIA_OBJECT_RENDERERS(6, true, true, false)
+MARIA_OBJECT_RENDERERS(7, true, true, true)
+
+static void (*const MARIA_STORE_DIRECT[8])(uint8_t) = {
+    maria_StoreDirect0, maria_StoreDirect1, maria_StoreDirect2, maria_StoreDirect3,
+    maria_StoreDirect4, maria_StoreDirect5, maria_StoreDirect6, maria_StoreDirect7
+};
+
+static void (*const MARIA_STORE_INDIRECT[8])(uint8_t, uint8_t) = {
+    maria_StoreIndirect0, maria_StoreIndirect1, maria_StoreIndirect2, maria_StoreIndirect3,
+    maria_StoreIndirect4, maria_StoreIndirect5, maria_StoreIndirect6, maria_StoreIndirect7
+};
+
+#if defined(MARIA_SSSE3)
+// Looks up sixteen line RAM entries in a 32 entry table held in two halves.
+// high marks the entries that index the second half.
+MARIA_SSSE3_TARGET static inline __m128i maria_Lookup(__m128i data, __m128i high, __m128i table0, __m128i table1) {
+    return _mm_or_si128(
+        _mm_andnot_si128(high, _mm_shuffle_epi8(table0, data)),
+        _mm_and_si128(high, _mm_shuffle_epi8(table1, data)));
+}
+
+MARIA_SSSE3_TARGET static void maria_ExpandLineRAMSSSE3(uint8_t* buffer, const uint8_t* lineRAM, const uint8_t* left, const uint8_t* right) {
+    const __m128i left0 = _mm_loadu_si128((const __m128i*)left);
+    const __m128i left1 = _mm_loadu_si128((const __m128i*)(left + 16));
+    const __m128i right0 = _mm_loadu_si128((const __m128i*)right);
+    const __m128i right1 = _mm_loadu_si128((const __m128i*)(right + 16));
+    const __m128i fifteen = _mm_set1_epi8(15);
+    
+    for (int index = 0; index < MARIA_LINERAM_SIZE; index += 16) {
+        __m128i data = _mm_loadu_si128((const __m128i*)(lineRAM + index));
+        __m128i high = _mm_cmpgt_epi8(data, fifteen);
+        __m128i first = maria_Lookup(data, high, left0, left1);
+        __m128i second = maria_Lookup(data, high, right0, right1);
+        _mm_storeu_si128((__m128i*)(buffer + (index << 1)), _mm_unpacklo_epi8(first, second));
+        _mm_storeu_si128((__m128i*)(buffer + (index << 1) + 16), _mm_unpackhi_epi8(first, second));
+    }
+}
+#endif
+
+// Writes out each line RAM entry as the pair of pixels given for its value
+// in left and right
+static inline void maria_ExpandLineRAM(uint8_t* buffer, const uint8_t* lineRAM, const uint8_t* left, const uint8_t* right) {
+#if defined(MARIA_SSSE3)
+    if (MARIA_HAS_SSSE3()) {
+        maria_ExpandLineRAMSSSE3(buffer, lineRAM, left, right);
+        return;
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    const uint8x16x2_t first = {{vld1q_u8(left), vld1q_u8(left + 16)}};
+    const uint8x16x2_t second = {{vld1q_u8(right), vld1q_u8(right + 16)}};
+    
+    for (int index = 0; index < MARIA_LINERAM_SIZE; index += 16) {
+        uint8x16_t data = vld1q_u8(lineRAM + index);
+        uint8x16x2_t pixels = {{vqtbl2q_u8(first, data), vqtbl2q_u8(second, data)}};
+        vst2q_u8(buffer + (index << 1), pixels);
+    }
+    return;
+#endif
+    int pixel = 0;
+    for (int index = 0; index < MARIA_LINERAM_SIZE; index++) {
+        uint8_t data = lineRAM[index];
+        buffer[pixel++] = left[data];
+        buffer[pixel++] = right[data];
+    }
+}
+
+// In color formats each line RAM value's two pixels are looked up as one
+// pair, and with SSE2 two pairs are stored at a time. Shuffling the colors
+// out of registers instead costs more than these loads.
+static inline void maria_ExpandLineRAM32(uint32_t* buffer, const uint8_t* lineRAM, const uint8_t* left, const uint8_t* right, const uint32_t* colors) {
+#if defined(__SSE2__)
+    uint64_t pairs[32];
+    
+    for (int data = 0; data < 32; data++) {
+        pairs[data] = colors[left[data]] | ((uint64_t)colors[right[data]] << 32);
+    }
+    
+    for (int index = 0; index < MARIA_LINERAM_SIZE; index += 2) {
+        __m128i pixels = _mm_loadl_epi64((const __m128i*)&pairs[lineRAM[index]]);
+        pixels = _mm_castpd_si128(_mm_loadh_pd(_mm_castsi128_pd(pixels), (const double*)&pairs[lineRAM[index + 1]]));
+        _mm_storeu_si128((__m128i*)(buffer + (index << 1)), pixels);
+    }
+#else
+    uint32_t first[32];
+    uint32_t second[32];
+    
+    for (int data = 0; data < 32; data++) {
+        first[data] = colors[left[data]];
+        second[data] = colors[right[data]];
+    }
+    
+    int pixel = 0;
+    for (int index = 0; index < MARIA_LINERAM_SIZE; index++) {
+        uint8_t data = lineRAM[index];
+        buffer[pixel++] = first[data];
+        buffer[pixel++] = second[data];
+    }
+#endif
+}
+
+static inline void maria_ExpandLineRAM16(uint16_t* buffer, const uint8_t* lineRAM, const uint8_t* left, const uint8_t* right, const uint32_t* colors) {
+#if defined(__SSE2__)
+    int32_t pairs[32];
+    
+    for (int data = 0; data < 32; data++) {
+        pairs[data] = (int32_t)((colors[left[data]] & 0xffff) | (colors[right[data]] << 16));
+    }
+    
+    for (int index = 0; index < MARIA_LINERAM_SIZE; index += 4) {
+        __m128i pixels = _mm_setr_epi32(pairs[lineRAM[index]], pairs[lineRAM[index + 1]], pairs[lineRAM[index + 2]], pairs[lineRAM[index + 3]]);
+        _mm_storeu_si128((__m128i*)(buffer + (index << 1)), pixels);
+    }
+#else
+    uint16_t first[32];
+    uint16_t second[32];
+    
+    for (int data = 0; data < 32; data++) {
+        first[data] = colors[left[data]];
+        second[data] = colors[right[data]];
+    }
+    
+    int pixel = 0;
+    for (int index = 0; index < MARIA_LINERAM_SIZE; index++) {
+        uint8_t data = lineRAM[index];
+        buffer[pixel++] = first[data];
+        buffer[pixel++] = second[data];
+    }
+#endif
+}
+
+// Writes out each line RAM entry as a single pixel, for 160 wide lines
+static inline void maria_CopyLineRAM(uint8_t* line, const uint8_t* lineRAM, const uint8_t* color, uint8_t format, const uint32_t* colors) {
+    if (format == MARIA_FORMAT_INDEXED8) {
+        for (int index = 0; index < MARIA_LINERAM_SIZE; index++) {
+            line[index] = color[lineRAM[index]];
         }
-        if (maria_h08 && (maria_pp.w & 2048)) {
-            return true;
+    }
+    else if (format == MARIA_FORMAT_RGB565) {
+        uint16_t* buffer = (uint16_t*)line;
+        for (int index = 0; index < MARIA_LINERAM_SIZE; index++) {
+            buffer[index] = colors[color[lineRAM[index]]];
+        }
+    }
+    else {
+        uint32_t* buffer = (uint32_t*)line;
+        for (int index = 0; index < MARIA_LINERAM_SIZE; index++) {
+            buffer[index] = colors[color[lineRAM[index]]];
         }
     }
-    return false;
 }
 
-static inline uint8_t maria_GetColor(uint8_t data) {
-    if (data & 3) {
-        return memory_ram[BACKGRND + data];
+static inline void maria_FillPixels(uint8_t* line, uint32_t width, uint8_t color, uint8_t format, const uint32_t* colors) {
+    if (format == MARIA_FORMAT_INDEXED8) {
+        for (uint32_t index = 0; index < width; index++) {
+            line[index] = color;
+        }
+    }
+    else if (format == MARIA_FORMAT_RGB565) {
+        uint16_t* buffer = (uint16_t*)line;
+        for (uint32_t index = 0; index < width; index++) {
+            buffer[index] = colors[color];
+        }
     }
     else {
-        return memory_ram[BACKGRND];
+        uint32_t* buffer = (uint32_t*)line;
+        for (uint32_t index = 0; index < width; index++) {
+            buffer[index] = colors[color];
+        }
     }
 }
 
-static inline void maria_StoreGraphic(void) {
-    uint8_t data = memory_ram[maria_pp.w];
-    if (maria_wmode) {
-        if (maria_IsHolyDMA()) {
-            maria_StoreCell2(0, 0);
-            maria_StoreCell2(0, 0);
+// Draws the line the job describes, from the given line RAM, in colors
+// converted to the job's format
+static void maria_DrawJob(const maria_job* job, const uint8_t* lineRAM, const uint32_t* colors) {
+    switch (job->kind) {
+        case MARIA_JOB_FILL:
+            maria_FillPixels(job->line, job->width, job->left[0], job->format, colors);
+            break;
+        
+        case MARIA_JOB_COPY:
+            maria_CopyLineRAM(job->line, lineRAM, job->left, job->format, colors);
+            break;
+        
+        default:
+            if (job->format == MARIA_FORMAT_INDEXED8) {
+                maria_ExpandLineRAM(job->line, lineRAM, job->left, job->right);
+            }
+            else if (job->format == MARIA_FORMAT_RGB565) {
+                maria_ExpandLineRAM16((uint16_t*)job->line, lineRAM, job->left, job->right, colors);
+            }
+            else {
+                maria_ExpandLineRAM32((uint32_t*)job->line, lineRAM, job->left, job->right, colors);
+            }
+            break;
+    }
+}
+
+#if defined(MARIA_THREADS)
+// Lines queued for drawing on a worker thread. The scanline loop fills in
+// jobs from head on and hands them over MARIA_JOB_BATCH at a time by moving
+// head past them; the worker draws the jobs from tail up to head and moves
+// tail on. Both only ever count up. seen is tail as the scanline loop last
+// saw it, which it can check without taking the mutex.
+struct MariaWorker {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t queued;
+    pthread_cond_t drawn;
+    const uint32_t* colors;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t pending;
+    uint32_t seen;
+    bool quit;
+    maria_job jobs[MARIA_JOB_COUNT];
+};
+
+static void* maria_Work(void* argument) {
+    maria_worker* worker = (maria_worker*)argument;
+    
+    pthread_mutex_lock(&worker->mutex);
+    for (;;) {
+        while (worker->tail == worker->head && !worker->quit) {
+            pthread_cond_wait(&worker->queued, &worker->mutex);
         }
-        else {
-            maria_StoreCell2((data & 12), (data & 192) >> 6);
-            maria_StoreCell2((data & 48) >> 4, (data & 3) << 2);
+        
+        uint32_t tail = worker->tail;
+        uint32_t head = worker->head;
+        if (tail == head) {
+            break;
+        }
+        
+        pthread_mutex_unlock(&worker->mutex);
+        for (; tail != head; tail++) {
+            const maria_job* job = &worker->jobs[tail % MARIA_JOB_COUNT];
+            maria_DrawJob(job, job->lineRAM, worker->colors);
         }
+        pthread_mutex_lock(&worker->mutex);
+        
+        worker->tail = tail;
+        pthread_cond_signal(&worker->drawn);
     }
-    else {
-        if(maria_IsHolyDMA()) {
-            maria_StoreCell(0);
-            maria_StoreCell(0);
-            maria_StoreCell(0);
-            maria_StoreCell(0);
+    pthread_mutex_unlock(&worker->mutex);
+    return NULL;
+}
+
+static maria_worker* maria_StartWorker(const uint32_t* colors) {
+    maria_worker* worker = (maria_worker*)calloc(1, sizeof(maria_worker));
+    if (worker == NULL) {
+        return NULL;
+    }
+    
+    worker->colors = colors;
+    pthread_mutex_init(&worker->mutex, NULL);
+    pthread_cond_init(&worker->queued, NULL);
+    pthread_cond_init(&worker->drawn, NULL);
+    if (pthread_create(&worker->thread, NULL, maria_Work, worker)) {
+        pthread_cond_destroy(&worker->drawn);
+        pthread_cond_destroy(&worker->queued);
+        pthread_mutex_destroy(&worker->mutex);
+        free(worker);
+        return NULL;
+    }
+    return worker;
+}
+
+// Hands the pending jobs to the worker. Called with the mutex held.
+static inline void maria_PublishJobs(maria_worker* worker) {
+    worker->seen = worker->tail;
+    if (worker->pending > 0) {
+        worker->head += worker->pending;
+        worker->pending = 0;
+        pthread_cond_signal(&worker->queued);
+    }
+}
+
+// Hands over every pending job and waits for all of them to be drawn
+static void maria_DrainWorker(maria_worker* worker) {
+    pthread_mutex_lock(&worker->mutex);
+    maria_PublishJobs(worker);
+    while (worker->tail != worker->head) {
+        pthread_cond_wait(&worker->drawn, &worker->mutex);
+    }
+    pthread_mutex_unlock(&worker->mutex);
+}
+
+// Draws whatever is still queued, then ends the thread
+static void maria_StopWorker(maria_worker* worker) {
+    maria_DrainWorker(worker);
+    
+    pthread_mutex_lock(&worker->mutex);
+    worker->quit = true;
+    pthread_cond_signal(&worker->queued);
+    pthread_mutex_unlock(&worker->mutex);
+    
+    pthread_join(worker->thread, NULL);
+    pthread_cond_destroy(&worker->drawn);
+    pthread_cond_destroy(&worker->queued);
+    pthread_mutex_destroy(&worker->mutex);
+    free(worker);
+}
+
+// The next free job, waiting for the worker if the queue is full. Only the
+// scanline loop touches head and pending between handovers.
+static maria_job* maria_ReserveJob(maria_worker* worker) {
+    if (worker->head + worker->pending - worker->seen >= MARIA_JOB_COUNT) {
+        pthread_mutex_lock(&worker->mutex);
+        maria_PublishJobs(worker);
+        while (worker->head - worker->tail == MARIA_JOB_COUNT) {
+            pthread_cond_wait(&worker->drawn, &worker->mutex);
         }
-        else {
-            maria_StoreCell((data & 192) >> 6);
-            maria_StoreCell((data & 48) >> 4);
-            maria_StoreCell((data & 12) >> 2);
-            maria_StoreCell(data & 3);
+        worker->seen = worker->tail;
+        pthread_mutex_unlock(&worker->mutex);
+    }
+    return &worker->jobs[(worker->head + worker->pending) % MARIA_JOB_COUNT];
+}
+
+static void maria_QueueJob(maria_worker* worker) {
+    if (++worker->pending == MARIA_JOB_BATCH) {
+        pthread_mutex_lock(&worker->mutex);
+        maria_PublishJobs(worker);
+        pthread_mutex_unlock(&worker->mutex);
+    }
+}
+#endif
+
+// A job to fill in for the current line. Jobs for the worker get a copy of
+// the line RAM, since the next line is built into maria_lineRAM while the
+// worker may still be drawing.
+static inline maria_job* maria_BeginJob(maria_job* local, uint8_t kind) {
+    maria_job* job = local;
+    
+#if defined(MARIA_THREADS)
+    if (maria_thread != NULL) {
+        job = maria_ReserveJob(maria_thread);
+        if (kind != MARIA_JOB_FILL) {
+            memcpy(job->lineRAM, maria_lineRAM, MARIA_LINERAM_SIZE);
+        }
+    }
+#endif
+    job->kind = kind;
+    job->format = (maria_output == NULL)? MARIA_FORMAT_INDEXED8: maria_format;
+    return job;
+}
+
+// Hands the job to the worker, or else draws it now
+static inline void maria_EndJob(maria_job* job) {
+#if defined(MARIA_THREADS)
+    if (maria_thread != NULL) {
+        maria_QueueJob(maria_thread);
+        return;
+    }
+#endif
+    maria_DrawJob(job, maria_lineRAM, maria_colors);
+}
+
+// The start of the current scanline in the caller's buffer, whose first row
+// is the top of the visible area, or else in maria_surface
+static inline uint8_t* maria_GetLine(void) {
+    if (maria_output != NULL) {
+        return maria_output + ((maria_scanline - maria_visibleArea.top) * maria_pitch);
+    }
+    return maria_surface + ((maria_scanline - maria_displayArea.top) *
+        ((maria_displayArea.right - maria_displayArea.left) + 1));
+}
+
+// The record of the current scanline, or NULL if it is outside the display
+// area
+static inline maria_line* maria_GetMemo(void) {
+    uint16_t row = maria_scanline - maria_displayArea.top;
+    
+    if (maria_scanline < maria_displayArea.top || row >= MARIA_SURFACE_HEIGHT) {
+        return NULL;
+    }
+    return &maria_lines[row];
+}
+
+// Forgets where every line was drawn, for when what was drawn there no
+// longer matches the inputs it was drawn from
+static void maria_ClearRows(void) {
+    for (int index = 0; index < MARIA_SURFACE_HEIGHT; index++) {
+        maria_lines[index].row = NULL;
+    }
+}
+
+// Sets lineFirst and lineLast to the first and last entries of line RAM
+// that differ from those given, which must not all match. Compares eight
+// entries at a time. Kept out of the scanline loop, which is faster without
+// it.
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void maria_FindChanges(const uint8_t* lineRAM) {
+    int first = 0;
+    int last = MARIA_LINERAM_SIZE - 8;
+    uint64_t before;
+    uint64_t after;
+    
+    for (;; first += 8) {
+        memcpy(&before, lineRAM + first, 8);
+        memcpy(&after, maria_lineRAM + first, 8);
+        if (before != after) {
+            break;
         }
     }
-    maria_pp.w++;
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    first += __builtin_ctzll(before ^ after) >> 3;
+#else
+    while (lineRAM[first] == maria_lineRAM[first]) {
+        first++;
+    }
+#endif
+    
+    for (;; last -= 8) {
+        memcpy(&before, lineRAM + last, 8);
+        memcpy(&after, maria_lineRAM + last, 8);
+        if (before != after) {
+            break;
+        }
+    }
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    last += 7 - (__builtin_clzll(before ^ after) >> 3);
+#else
+    last += 7;
+    while (lineRAM[last] == maria_lineRAM[last]) {
+        last--;
+    }
+#endif
+    
+    maria_lineFirst = first;
+    maria_lineLast = last;
+}
+
+// Notes columns left through right of the current row as changed
+static inline void maria_Damage(maria_line* memo, uint16_t left, uint16_t right) {
+    if (memo != NULL) {
+        memo->damageLeft = left;
+        memo->damageRight = right;
+    }
+}
+
+static inline void maria_FillLine(uint8_t color) {
+    uint8_t* line = maria_GetLine();
+    maria_line* memo = maria_GetMemo();
+    uint32_t width = MARIA_LINERAM_SIZE * 2;
+    
+    if (memo != NULL) {
+        if (memo->row == line && memo->rowFill && memo->rowColors[0] == color) {
+            return;
+        }
+        memo->row = line;
+        memo->rowFill = true;
+        memo->rowColors[0] = color;
+    }
+    
+    if (maria_narrow) {
+        width = MARIA_LINERAM_SIZE;
+    }
+    maria_narrowLine[maria_scanline - maria_visibleArea.top] = maria_narrow;
+    maria_Damage(memo, 0, width - 1);
+    
+    maria_job local;
+    maria_job* job = maria_BeginJob(&local, MARIA_JOB_FILL);
+    job->line = line;
+    job->width = width;
+    job->left[0] = color;
+    maria_EndJob(job);
 }
 
-static inline void maria_WriteLineRAM(uint8_t* buffer) {
+// Line RAM entries are at most five bits, so the colors of the two pixels
+// every possible entry stands for are worked out once for the line and then
+// looked up. With same set the line RAM is what the line was last drawn
+// from, and the line is left alone if it is still drawn where it was, with
+// the same registers. If only the line RAM changed, only the columns of the
+// entries that changed are noted as damaged. Line RAM not stored on the
+// scanline before, as when DMA is turned on mid frame, is drawn but not
+// remembered.
+static inline void maria_WriteLineRAM(bool stored, bool same) {
     uint8_t rmode = memory_ram[CTRL] & 3;
-    if (rmode == 0) { // 160A/B
-        int pixel = 0;
-        for (int index = 0; index < MARIA_LINERAM_SIZE; index += 4) {
-            uint16_t color;
-            color = maria_GetColor(maria_lineRAM[index + 0]);
-            buffer[pixel++] = color;
-            buffer[pixel++] = color;
-            color = maria_GetColor(maria_lineRAM[index + 1]);
-            buffer[pixel++] = color;
-            buffer[pixel++] = color;
-            color = maria_GetColor(maria_lineRAM[index + 2]);
-            buffer[pixel++] = color;
-            buffer[pixel++] = color;
-            color = maria_GetColor(maria_lineRAM[index + 3]);
-            buffer[pixel++] = color;
-            buffer[pixel++] = color;
+    uint8_t color[32];
+    uint8_t* line = maria_GetLine();
+    maria_line* memo = maria_GetMemo();
+    bool partial = false;
+    
+    if (memo != NULL) {
+        const uint8_t* colors = memory_ram + BACKGRND;
+        if (memo->row == line && !memo->rowFill && memo->rowCtrl == memory_ram[CTRL] &&
+            !memcmp(memo->rowColors, colors, sizeof(memo->rowColors))) {
+            if (same) {
+                return;
+            }
+            partial = stored;
+        }
+        memo->row = stored? line: NULL;
+        memo->rowFill = false;
+        memo->rowCtrl = memory_ram[CTRL];
+        memcpy(memo->rowColors, colors, sizeof(memo->rowColors));
+    }
+    
+    if (rmode == 1) {
+        return;
+    }
+    
+    for (int data = 0; data < 32; data++) {
+        color[data] = maria_GetColor(data);
+    }
+    
+    bool narrow = maria_narrow && rmode == 0;
+    maria_narrowLine[maria_scanline - maria_visibleArea.top] = narrow;
+    
+    if (!partial) {
+        maria_Damage(memo, 0, narrow? MARIA_LINERAM_SIZE - 1: (MARIA_LINERAM_SIZE * 2) - 1);
+    }
+    else if (narrow) {
+        maria_Damage(memo, maria_lineFirst, maria_lineLast);
+    }
+    else {
+        maria_Damage(memo, maria_lineFirst * 2, (maria_lineLast * 2) + 1);
+    }
+    
+    maria_job local;
+    maria_job* job = maria_BeginJob(&local, narrow? MARIA_JOB_COPY: MARIA_JOB_EXPAND);
+    uint8_t* left = job->left;
+    uint8_t* right = job->right;
+    job->line = line;
+    
+    if (narrow) {
+        memcpy(left, color, sizeof(color));
+    }
+    else if (rmode == 0) { // 160A/B
+        for (int data = 0; data < 32; data++) {
+            left[data] = color[data];
+            right[data] = color[data];
         }
     }
     else if (rmode == 2) { // 320B/D
-        int pixel = 0;
-        for (int index = 0; index < MARIA_LINERAM_SIZE; index += 4) {
-            buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 0] & 16) | ((maria_lineRAM[index + 0] & 8) >> 3) | ((maria_lineRAM[index + 0] & 2)));
-            buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 0] & 16) | ((maria_lineRAM[index + 0] & 4) >> 2) | ((maria_lineRAM[index + 0] & 1) << 1));
-            buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 1] & 16) | ((maria_lineRAM[index + 1] & 8) >> 3) | ((maria_lineRAM[index + 1] & 2)));
-            buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 1] & 16) | ((maria_lineRAM[index + 1] & 4) >> 2) | ((maria_lineRAM[index + 1] & 1) << 1));
-            buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 2] & 16) | ((maria_lineRAM[index + 2] & 8) >> 3) | ((maria_lineRAM[index + 2] & 2)));
-            buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 2] & 16) | ((maria_lineRAM[index + 2] & 4) >> 2) | ((maria_lineRAM[index + 2] & 1) << 1));
-            buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 3] & 16) | ((maria_lineRAM[index + 3] & 8) >> 3) | ((maria_lineRAM[index + 3] & 2)));
-            buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 3] & 16) | ((maria_lineRAM[index + 3] & 4) >> 2) | ((maria_lineRAM[index + 3] & 1) << 1));
+        for (int data = 0; data < 32; data++) {
+            left[data] = color[(data & 16) | ((data & 8) >> 3) | (data & 2)];
+            right[data] = color[(data & 16) | ((data & 4) >> 2) | ((data & 1) << 1)];
         }
     }
-    else if (rmode == 3) { // 320A/C
-        int pixel = 0;
-        for (int index = 0; index < MARIA_LINERAM_SIZE; index += 4) {
-            buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 0] & 30));
-            buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 0] & 28) | ((maria_lineRAM[index + 0] & 1) << 1));
-            buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 1] & 30));
-            buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 1] & 28) | ((maria_lineRAM[index + 1] & 1) << 1));
-            buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 2] & 30));
-            buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 2] & 28) | ((maria_lineRAM[index + 2] & 1) << 1));
-            buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 3] & 30));
-            buffer[pixel++] = maria_GetColor((maria_lineRAM[index + 3] & 28) | ((maria_lineRAM[index + 3] & 1) << 1));
+    else { // 320A/C
+        for (int data = 0; data < 32; data++) {
+            left[data] = color[data & 30];
+            right[data] = color[(data & 28) | ((data & 1) << 1)];
         }
     }
+    maria_EndJob(job);
 }
 
-static inline void maria_StoreLineRAM(void) {
-    for(int index = 0; index < MARIA_LINERAM_SIZE; index++) {
-        maria_lineRAM[index] = 0;
+// Decodes the display list header at dp and returns the address of the
+// header after it
+static inline uint16_t maria_DecodeObject(uint16_t dp, maria_object* object) {
+    uint8_t mode = memory_Peek(dp + 1);
+    
+    object->pp.b.l = memory_Peek(dp);
+    object->pp.b.h = memory_Peek(dp + 2);
+    
+    if (mode & 31) {
+        object->mode = 0;
+        object->palette = (mode & 224) >> 3;
+        object->horizontal = memory_Peek(dp + 3);
+        object->width = ((~mode) & 31) + 1;
+        return dp + 4;
     }
     
-    uint8_t mode = memory_ram[maria_dp.w + 1];
-    while(mode & 0x5f) {
-        uint8_t width;
-        uint8_t indirect = 0;
+    uint8_t width = memory_Peek(dp + 3) & 31;
+    object->mode = MARIA_OBJECT_EXTENDED;
+    if (mode & 32) {
+        object->mode |= MARIA_OBJECT_INDIRECT;
+    }
+    if (mode & 128) {
+        object->mode |= MARIA_OBJECT_WMODE;
+    }
+    object->palette = (memory_Peek(dp + 3) & 224) >> 3;
+    object->horizontal = memory_Peek(dp + 4);
+    object->width = (width == 0)? 32: ((~width) & 31) + 1;
+    return dp + 5;
+}
+
+static inline void maria_StoreObject(const maria_object* object) {
+    uint8_t width = object->width;
+    
+    maria_pp = object->pp;
+    maria_palette = object->palette;
+    maria_horizontal = object->horizontal;
+    
+    if (object->mode & MARIA_OBJECT_EXTENDED) {
+        maria_cycles += 12; // Maria cycles (Header 5 uint8_t)
+        maria_wmode = (object->mode & MARIA_OBJECT_WMODE)? 128: 0;
+    }
+    else {
+        maria_cycles += 8; // Maria cycles (Header 4 uint8_t)
+    }
+    
+    uint8_t renderer = (maria_wmode? 4: 0) | ((memory_ram[CTRL] & 4)? 2: 0) | ((maria_h08 || maria_h16)? 1: 0);
+    if (!(object->mode & MARIA_OBJECT_INDIRECT)) {
+        maria_pp.b.h += maria_offset;
+        maria_cycles += 3 * width; // Maria cycles (Direct graphic read)
+        if (!maria_skip) {
+            MARIA_STORE_DIRECT[renderer](width);
+        }
+    }
+    else {
+        uint8_t bytes = (memory_ram[CTRL] & 16)? 2: 1;
+        // Maria cycles (Indirect, Indirect 1 uint8_t, Indirect 2 uint8_ts)
+        maria_cycles += (3 + (3 * bytes)) * width;
+        if (!maria_skip) {
+            MARIA_STORE_INDIRECT[renderer](width, bytes);
+        }
+    }
+}
+
+// Adds pages first through last, wrapping past $FF, to the count pages in
+// pages. Fails if that would make more than limit of them, or if one is a
+// register page, which the hardware changes without the CPU writing to it.
+static bool maria_AddPages(uint8_t* pages, uint8_t* count, uint8_t limit, uint8_t first, uint8_t last) {
+    for (uint8_t page = first; ; page++) {
+        if (page <= 0x02) {
+            return false;
+        }
         
-        maria_pp.b.l = memory_ram[maria_dp.w];
-        maria_pp.b.h = memory_ram[maria_dp.w + 2];
+        uint8_t index = 0;
+        while (index < *count && pages[index] != page) {
+            index++;
+        }
+        if (index == *count) {
+            if (*count == limit) {
+                return false;
+            }
+            pages[(*count)++] = page;
+        }
         
-        if (mode & 31) {
-            maria_cycles += 8; // Maria cycles (Header 4 uint8_t)
-            maria_palette = (memory_ram[maria_dp.w + 1] & 224) >> 3;
-            maria_horizontal = memory_ram[maria_dp.w + 3];
-            width = memory_ram[maria_dp.w + 1] & 31;
-            width = ((~width) & 31) + 1;
-            maria_dp.w += 4;
+        if (page == last) {
+            return true;
         }
-        else {
-            maria_cycles += 12; // Maria cycles (Header 5 uint8_t)
-            maria_palette = (memory_ram[maria_dp.w + 3] & 224) >> 3;
-            maria_horizontal = memory_ram[maria_dp.w + 4];
-            indirect = memory_ram[maria_dp.w + 1] & 32;
-            maria_wmode = memory_ram[maria_dp.w + 1] & 128;
-            width = memory_ram[maria_dp.w + 3] & 31;
-            width = (width == 0)? 32: ((~width) & 31) + 1;
-            maria_dp.w += 5;
+    }
+}
+
+// Has the CPU writes to the pages counted from now on, and notes how many
+// there have been so far
+static void maria_TrackPages(const uint8_t* pages, uint32_t* serial, uint8_t count) {
+    for (uint8_t index = 0; index < count; index++) {
+        memory_Track(pages[index]);
+        serial[index] = memory_serial[pages[index]];
+    }
+}
+
+// Whether none of the pages has changed since maria_TrackPages
+static inline bool maria_IsCurrent(const uint8_t* pages, const uint32_t* serial, uint8_t count) {
+    for (uint8_t index = 0; index < count; index++) {
+        if (memory_serial[pages[index]] != serial[index]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Decodes the display list at maria_dp into maria_objects, so the other lines
+// of the zone can replay it for as long as the pages the list sits on are
+// not written or remapped. Lists that are too long, or that sit on the
+// register pages, are left invalid and decoded on every line.
+static void maria_DecodeZone(void) {
+    uint16_t dp = maria_dp.w;
+    uint8_t count = 0;
+    
+    maria_zone = dp;
+    maria_zoneValid = false;
+    maria_zonePageCount = 0;
+    
+    while (memory_Peek(dp + 1) & 0x5f) {
+        if (count == MARIA_OBJECT_COUNT) {
+            return;
+        }
+        dp = maria_DecodeObject(dp, &maria_objects[count++]);
+    }
+    maria_objectCount = count;
+    
+    if (maria_AddPages(maria_zonePage, &maria_zonePageCount, MARIA_ZONE_PAGES, maria_zone >> 8, (uint16_t)(dp + 1) >> 8)) {
+        maria_TrackPages(maria_zonePage, maria_zoneSerial, maria_zonePageCount);
+        maria_zoneValid = true;
+    }
+}
+
+// Adds the pages the object's graphics are read from to the line's pages
+static bool maria_AddObjectPages(maria_line* line, const maria_object* object) {
+    bool indirect = object->mode & MARIA_OBJECT_INDIRECT;
+    pair pp = object->pp;
+    
+    if (!indirect) {
+        pp.b.h += maria_offset;
+    }
+    
+    uint8_t last = (uint16_t)(pp.w + object->width - 1) >> 8;
+    if (!maria_AddPages(line->page, &line->pageCount, MARIA_LINE_PAGES, pp.b.h, last)) {
+        return false;
+    }
+    
+    // Indirect objects read character numbers from pp, then their graphics
+    // from the character base on
+    if (indirect) {
+        uint8_t base = memory_ram[CHARBASE] + maria_offset;
+        uint8_t top = (memory_ram[CTRL] & 16)? base + 1: base;
+        return maria_AddPages(line->page, &line->pageCount, MARIA_LINE_PAGES, base, top);
+    }
+    return true;
+}
+
+// Notes the pages the line's display list and graphics were read from, so
+// the line can be reused while none of them changes. Fails for lines that
+// could not be replayed from the decoded zone, or that read too many pages.
+static bool maria_TrackLine(maria_line* line) {
+    line->pageCount = 0;
+    
+    if (!maria_zoneValid) {
+        return false;
+    }
+    
+    for (uint8_t index = 0; index < maria_zonePageCount; index++) {
+        line->page[index] = maria_zonePage[index];
+    }
+    line->pageCount = maria_zonePageCount;
+    
+    for (uint8_t index = 0; index < maria_objectCount; index++) {
+        if (!maria_AddObjectPages(line, &maria_objects[index])) {
+            return false;
+        }
+    }
+    
+    maria_TrackPages(line->page, line->serial, line->pageCount);
+    return true;
+}
+
+// Whether the line's line RAM was built from the same display list,
+// graphics and registers as on the last frame
+static inline bool maria_IsLineCurrent(const maria_line* line) {
+    return line->valid &&
+        line->dp == maria_dp.w &&
+        line->offset == maria_offset &&
+        line->dma == (maria_h08 | maria_h16) &&
+        line->wmode == maria_wmode &&
+        line->ctrl == memory_ram[CTRL] &&
+        line->charbase == memory_ram[CHARBASE] &&
+        maria_IsCurrent(line->page, line->serial, line->pageCount);
+}
+
+// Builds the line RAM for the next scanline. A line with nothing changed
+// since the last frame takes its line RAM, DMA cycles and resulting write
+// mode from then instead. When skipping, only the display list is walked,
+// for its DMA cycles and write mode, and the line is left as it was last
+// built.
+static inline void maria_StoreLineRAM(void) {
+    maria_line* line = maria_GetMemo();
+    uint32_t cycles = maria_cycles;
+    uint8_t wmode = maria_wmode;
+    
+    if (line != NULL && maria_IsLineCurrent(line)) {
+        if (!maria_skip) {
+            memcpy(maria_lineRAM, line->lineRAM, MARIA_LINERAM_SIZE);
+            maria_lineStored = true;
+            maria_lineSame = true;
+        }
+        maria_cycles += line->cycles;
+        maria_wmode = line->wmodeAfter;
+        return;
+    }
+    
+    if (!maria_skip) {
+        for(int index = 0; index < MARIA_LINERAM_SIZE; index++) {
+            maria_lineRAM[index] = 0;
+        }
+    }
+    
+    if (!maria_zoneValid || maria_zone != maria_dp.w ||
+        !maria_IsCurrent(maria_zonePage, maria_zoneSerial, maria_zonePageCount)) {
+        maria_DecodeZone();
+    }
+    
+    if (maria_zoneValid) {
+        for (uint8_t index = 0; index < maria_objectCount; index++) {
+            maria_StoreObject(&maria_objects[index]);
+        }
+    }
+    else {
+        maria_object object;
+        uint16_t dp = maria_dp.w;
+        while (memory_Peek(dp + 1) & 0x5f) {
+            dp = maria_DecodeObject(dp, &object);
+            maria_StoreObject(&object);
+        }
+    }
+    
+    // The record keeps the line RAM the line was last drawn from, so that
+    // the next frame drawn is still compared against what is on screen
+    if (line != NULL && maria_skip) {
+        line->valid = false;
+    }
+    else if (line != NULL) {
+        maria_lineStored = true;
+        maria_lineSame = !memcmp(line->lineRAM, maria_lineRAM, MARIA_LINERAM_SIZE);
+        if (!maria_lineSame) {
+            maria_FindChanges(line->lineRAM);
+            memcpy(line->lineRAM, maria_lineRAM, MARIA_LINERAM_SIZE);
         }
         
-        if (!indirect) {
-            maria_pp.b.h += maria_offset;
-            for (int index = 0; index < width; index++) {
-                maria_cycles += 3; // Maria cycles (Direct graphic read)
-                maria_StoreGraphic( );
-            }
+        // A line that changed since the last frame is likely to change again,
+        // so it is only tracked again after a few frames
+        if (line->valid) {
+            line->valid = false;
+            line->retry = MARIA_LINE_RETRY;
+        }
+        if (line->retry > 0) {
+            line->retry--;
         }
         else {
-            uint8_t cwidth = memory_ram[CTRL] & 16;
-            pair basePP = maria_pp;
-            for (int index = 0; index < width; index++) {
-                maria_cycles += 3; // Maria cycles (Indirect)
-                maria_pp.b.l = memory_ram[basePP.w++];
-                maria_pp.b.h = memory_ram[CHARBASE] + maria_offset;
-                
-                maria_cycles += 3; // Maria cycles (Indirect, 1 uint8_t)
-                maria_StoreGraphic( );
-                
-                if (cwidth) {
-                    maria_cycles += 3; // Maria cycles (Indirect, 2 uint8_ts)
-                    maria_StoreGraphic( );
-                }
-            }
+            line->valid = maria_TrackLine(line);
         }
-        mode = memory_ram[maria_dp.w + 1];
+        line->dp = maria_dp.w;
+        line->offset = maria_offset;
+        line->dma = maria_h08 | maria_h16;
+        line->wmode = wmode;
+        line->ctrl = memory_ram[CTRL];
+        line->charbase = memory_ram[CHARBASE];
+        line->wmodeAfter = maria_wmode;
+        line->cycles = maria_cycles - cycles;
     }
 }
 
 void maria_Reset(void) {
+    maria_Flush();
     maria_scanline = 1;
     
     for(int index = 0; index < MARIA_SURFACE_SIZE; index++) {
@@ -251,24 +1062,28 @@ void maria_Reset(void) {
     maria_h08 = 0;
     maria_h16 = 0;
     maria_wmode = 0;
+    maria_ClearMemo();
 }
 
 uint32_t maria_RenderScanline(void) {
+    bool stored = maria_lineStored;
+    bool same = maria_lineSame;
+    
+    if (maria_redraw) {
+        maria_ClearMemo();
+    }
+    
     maria_cycles = 0;
+    maria_lineStored = false;
+    maria_lineSame = false;
+    maria_Damage(maria_GetMemo(), MARIA_LINERAM_SIZE * 2, 0);
     
     // lightgun flash
     // Displays the background color when Maria is disabled (if applicable)
-    if (((memory_ram[CTRL] & 96 ) != 64 ) &&
+    if (!maria_skip && ((memory_ram[CTRL] & 96 ) != 64 ) &&
         maria_scanline >= maria_visibleArea.top &&
         maria_scanline <= maria_visibleArea.bottom) {
-        uint8_t bgcolor = maria_GetColor(0);
-        uint8_t *bgstart = maria_surface + ((maria_scanline - maria_displayArea.top) *
-            ((maria_displayArea.right - maria_displayArea.left) + 1));
-        
-        for(uint32_t index = 0; index < MARIA_LINERAM_SIZE; index++ ) {
-            *bgstart++ = bgcolor;
-            *bgstart++ = bgcolor;
-        }
+        maria_FillLine(maria_GetColor(0));
     }
     
     if ((memory_ram[CTRL] & 96) == 64 && maria_scanline >= maria_displayArea.top && maria_scanline <= maria_displayArea.bottom) {
@@ -278,37 +1093,36 @@ uint32_t maria_RenderScanline(void) {
             maria_cycles += 10; // Maria cycles (End of VBLANK)
             maria_dpp.b.l = memory_ram[DPPL];
             maria_dpp.b.h = memory_ram[DPPH];
-            maria_h08 = memory_ram[maria_dpp.w] & 32;
-            maria_h16 = memory_ram[maria_dpp.w] & 64;
-            maria_offset = memory_ram[maria_dpp.w] & 15;
-            maria_dp.b.l = memory_ram[maria_dpp.w + 2];
-            maria_dp.b.h = memory_ram[maria_dpp.w + 1];
+            maria_h08 = memory_Peek(maria_dpp.w) & 32;
+            maria_h16 = memory_Peek(maria_dpp.w) & 64;
+            maria_offset = memory_Peek(maria_dpp.w) & 15;
+            maria_dp.b.l = memory_Peek(maria_dpp.w + 2);
+            maria_dp.b.h = memory_Peek(maria_dpp.w + 1);
             
-            if (memory_ram[maria_dpp.w] & 128) {
+            if (memory_Peek(maria_dpp.w) & 128) {
                 maria_cycles += 20; // Maria cycles (NMI)  /*29, 16, 20*/
-                sally_ExecuteNMI( );
+                prosystem_nmis++;
             }
         }
-        else if (maria_scanline >= maria_visibleArea.top && maria_scanline <= maria_visibleArea.bottom) {
-            maria_WriteLineRAM(maria_surface + ((maria_scanline - maria_displayArea.top) *
-                ((maria_displayArea.right - maria_displayArea.left) + 1)));
+        else if (!maria_skip && maria_scanline >= maria_visibleArea.top && maria_scanline <= maria_visibleArea.bottom) {
+            maria_WriteLineRAM(stored, same);
         }
         
         if (maria_scanline != maria_displayArea.bottom) {
-            maria_dp.b.l = memory_ram[maria_dpp.w + 2];
-            maria_dp.b.h = memory_ram[maria_dpp.w + 1];
+            maria_dp.b.l = memory_Peek(maria_dpp.w + 2);
+            maria_dp.b.h = memory_Peek(maria_dpp.w + 1);
             maria_StoreLineRAM( );
             maria_offset--;
             
             if (maria_offset < 0) {
                 maria_cycles += 10; // Maria cycles (Last line of zone) /*20*/
                 maria_dpp.w += 3;
-                maria_h08 = memory_ram[maria_dpp.w] & 32;
-                maria_h16 = memory_ram[maria_dpp.w] & 64;
-                maria_offset = memory_ram[maria_dpp.w] & 15;
-                    if(memory_ram[maria_dpp.w] & 128) {
+                maria_h08 = memory_Peek(maria_dpp.w) & 32;
+                maria_h16 = memory_Peek(maria_dpp.w) & 64;
+                maria_offset = memory_Peek(maria_dpp.w) & 15;
+                    if(memory_Peek(maria_dpp.w) & 128) {
                         maria_cycles += 20; // Maria cycles (NMI) /*29, 16, 20*/
-                        sally_ExecuteNMI( );
+                        prosystem_nmis++;
                     }
             }
             else {
@@ -320,7 +1134,213 @@ uint32_t maria_RenderScanline(void) {
 }
 
 void maria_Clear(void) {
+    maria_Flush();
     for(int index = 0; index < MARIA_SURFACE_SIZE; index++) {
         maria_surface[index] = 0;
     }
+    maria_ClearRows();
+}
+
+// Renders the visible lines straight into buffer, pitch bytes apart, in the
+// given format, instead of into maria_surface. Passing NULL goes back to
+// the surface. Lines that come out the same as on the last frame are not
+// written again, so the buffer must keep its contents between frames.
+void maria_SetOutput(void* buffer, uint32_t pitch, uint8_t format) {
+    maria_Flush();
+    if ((uint8_t*)buffer != maria_output || pitch != maria_pitch || format != maria_format) {
+        maria_ClearRows();
+    }
+    maria_output = (uint8_t*)buffer;
+    maria_pitch = pitch;
+    maria_format = format;
+    maria_LoadPalette();
+}
+
+// With narrow set, lines drawn in 160A/B and lines of plain background are
+// written 160 pixels wide, one per line RAM entry, rather than with every
+// pixel doubled. Lines in the 320 modes are written 320 wide as always, so
+// maria_GetLineWidth tells which is which.
+void maria_SetNarrow(bool narrow) {
+    if (narrow != maria_narrow) {
+        maria_narrow = narrow;
+        maria_ClearRows();
+    }
+}
+
+// With skip set, frames are run without drawing anything. Display lists are
+// still walked, so DMA steals the same cycles and raises the same NMIs, but
+// no graphics are stored to line RAM and the output is left as the last
+// frame drawn left it. Meant to be set for the frames of a fast forward or
+// run ahead that are never shown.
+void maria_SetSkip(bool skip) {
+    maria_skip = skip;
+}
+
+// With redraw set, every line is decoded from memory and drawn in full,
+// without the decoded zone or anything kept from the last frame, for
+// comparing against them.
+void maria_SetRedraw(bool redraw) {
+    maria_redraw = redraw;
+}
+
+// The width of the given line of the visible area as last drawn
+uint16_t maria_GetLineWidth(uint16_t row) {
+    if (row < MARIA_SURFACE_HEIGHT && maria_narrowLine[row]) {
+        return MARIA_LINERAM_SIZE;
+    }
+    return MARIA_LINERAM_SIZE * 2;
+}
+
+// Whether every line of the visible area was drawn 160 wide, so the frame
+// can be taken as a whole at that width
+bool maria_IsNarrow(void) {
+    for (uint16_t row = 0; row <= maria_visibleArea.bottom - maria_visibleArea.top; row++) {
+        if (maria_GetLineWidth(row) != MARIA_LINERAM_SIZE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Which columns of the given line of the visible area changed on the last
+// frame, counted in the line's own width. Returns false if none did.
+bool maria_GetRowDamage(uint16_t row, uint16_t* left, uint16_t* right) {
+    uint32_t line = row + maria_visibleArea.top - maria_displayArea.top;
+    
+    if (row > maria_visibleArea.bottom - maria_visibleArea.top || line >= MARIA_SURFACE_HEIGHT ||
+        maria_lines[line].damageLeft > maria_lines[line].damageRight) {
+        return false;
+    }
+    *left = maria_lines[line].damageLeft;
+    *right = maria_lines[line].damageRight;
+    return true;
+}
+
+// The smallest part of the visible area holding everything that changed on
+// the last frame, with the columns of 160 wide lines doubled. Returns false
+// if nothing did.
+bool maria_GetDamage(rect* area) {
+    bool damaged = false;
+    
+    for (uint16_t row = 0; row <= maria_visibleArea.bottom - maria_visibleArea.top; row++) {
+        uint16_t left;
+        uint16_t right;
+        
+        if (!maria_GetRowDamage(row, &left, &right)) {
+            continue;
+        }
+        if (maria_GetLineWidth(row) == MARIA_LINERAM_SIZE) {
+            left *= 2;
+            right = (right * 2) + 1;
+        }
+        
+        if (!damaged) {
+            area->left = left;
+            area->top = row;
+            area->right = right;
+            damaged = true;
+        }
+        if (left < area->left) {
+            area->left = left;
+        }
+        if (right > area->right) {
+            area->right = right;
+        }
+        area->bottom = row;
+    }
+    return damaged;
+}
+
+// Converts palette_data into the output format. palette_Load calls this, so
+// it only needs calling if palette_data is changed directly.
+void maria_LoadPalette(void) {
+    bool changed = false;
+    
+    maria_Flush();
+    
+    for (int index = 0; index < 256; index++) {
+        uint8_t r = palette_data[(index * 3) + 0];
+        uint8_t g = palette_data[(index * 3) + 1];
+        uint8_t b = palette_data[(index * 3) + 2];
+        uint32_t color;
+        
+        switch (maria_format) {
+            case MARIA_FORMAT_XRGB8888:
+                color = (r << 16) | (g << 8) | b;
+                break;
+            
+            case MARIA_FORMAT_BGRA8888: {
+                uint8_t bytes[4] = {b, g, r, 255};
+                memcpy(&color, bytes, sizeof(bytes));
+                break;
+            }
+            
+            case MARIA_FORMAT_RGB565:
+                color = ((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3);
+                break;
+            
+            default:
+                color = index;
+                break;
+        }
+        
+        changed |= (color != maria_colors[index]);
+        maria_colors[index] = color;
+    }
+    
+    // Lines already drawn in the old colors
+    if (changed) {
+        maria_ClearRows();
+    }
+}
+
+// Drops the decoded display list and everything kept from the last frame.
+// Must be called when memory_ram is replaced other than through the CPU.
+void maria_ClearMemo(void) {
+    maria_zoneValid = false;
+    maria_lineStored = false;
+    maria_lineSame = false;
+    for (int index = 0; index < MARIA_SURFACE_HEIGHT; index++) {
+        maria_lines[index].valid = false;
+        maria_lines[index].retry = 0;
+        maria_lines[index].row = NULL;
+    }
+}
+
+// With threaded set, only the last step of drawing a line, turning its
+// line RAM into pixels in the output format, runs on a thread of its own.
+// Walking the display lists, fetching graphics and rendering objects into
+// line RAM all stay on the CPU's thread: DMA timing comes from that walk,
+// and the line memo and damage tracking compare line RAM there. Each line
+// is handed over with its line RAM and the registers it is drawn with, and
+// prosystem_ExecuteFrame waits for the frame to be drawn before it returns,
+// so frames come out the same either way. Returns whether lines are now
+// drawn on the thread, which is never the case on builds without threads,
+// including all _WIN32 builds.
+bool maria_SetThreaded(bool threaded) {
+#if defined(MARIA_THREADS)
+    if (threaded && maria_thread == NULL) {
+        maria_thread = maria_StartWorker(maria_colors);
+    }
+    else if (!threaded && maria_thread != NULL) {
+        maria_StopWorker(maria_thread);
+        maria_thread = NULL;
+    }
+    return maria_thread != NULL;
+#else
+    return false;
+#endif
+}
+
+// Waits until every line handed to the thread has been drawn
+void maria_Flush(void) {
+#if defined(MARIA_THREADS)
+    if (maria_thread != NULL) {
+        maria_DrainWorker(maria_thread);
+    }
+#endif
+}
+
+void maria_Release(void) {
+    maria_SetThreaded(false);
 }
@@ -27,6 +27,7 @@
 #define MARIA_H
 
 #define MARIA_SURFACE_SIZE 93440
+#define MARIA_SURFACE_HEIGHT (MARIA_SURFACE_SIZE / 320)
 
 #include "Equates.h"
 #include "Pair.h"
@@ -34,12 +35,132 @@
 #include "Rect.h"
 #include "Sally.h"
 
+#define MARIA_LINERAM_SIZE 160
+
+// Line RAM as addressed by the 8 bit horizontal position. Only the first
+// MARIA_LINERAM_SIZE entries are displayed.
+#define MARIA_LINERAM_SPAN 256
+
+// Most objects one zone's decoded display list can hold; longer lists are
+// decoded on every line
+#define MARIA_OBJECT_COUNT 128
+
+// Most pages a decoded display list, and a memoized line's display list
+// and graphics, may be read from
+#define MARIA_ZONE_PAGES 4
+#define MARIA_LINE_PAGES 16
+
+typedef struct MariaObject {
+    pair pp;
+    uint8_t palette;
+    uint8_t horizontal;
+    uint8_t width;
+    uint8_t mode;
+} maria_object;
+
+// What one line of the display area was last built and drawn from. The
+// line RAM built on a line is drawn on the line after it.
+typedef struct MariaLine {
+    bool valid;
+    uint8_t retry;
+    uint16_t dp;
+    signed char offset;
+    uint8_t dma;
+    uint8_t wmode;
+    uint8_t ctrl;
+    uint8_t charbase;
+    uint8_t pageCount;
+    uint8_t page[MARIA_LINE_PAGES];
+    uint32_t serial[MARIA_LINE_PAGES];
+    uint8_t lineRAM[MARIA_LINERAM_SIZE];
+    uint8_t wmodeAfter;
+    uint32_t cycles;
+    // Where the line was drawn, and the registers it was drawn with. A row
+    // filled with the background color has rowFill set.
+    uint8_t* row;
+    bool rowFill;
+    uint8_t rowCtrl;
+    uint8_t rowColors[32];
+    // The columns the last frame changed, or left past right if none
+    uint16_t damageLeft;
+    uint16_t damageRight;
+} maria_line;
+
+// Pixel formats Maria can render straight into a caller's buffer. XRGB8888
+// and RGB565 are native endian words; BGRA8888 is bytes in that order with
+// alpha set.
+#define MARIA_FORMAT_INDEXED8 0
+#define MARIA_FORMAT_XRGB8888 1
+#define MARIA_FORMAT_BGRA8888 2
+#define MARIA_FORMAT_RGB565 3
+
+// The thread line RAM is turned into pixels on when drawing is threaded
+typedef struct MariaWorker maria_worker;
+
+typedef struct MariaState {
+    rect displayArea;
+    rect visibleArea;
+    uint8_t surface[MARIA_SURFACE_SIZE];
+    uint16_t scanline;
+    uint8_t lineRAM[MARIA_LINERAM_SPAN];
+    uint32_t cycles;
+    pair dpp;
+    pair dp;
+    pair pp;
+    uint8_t horizontal;
+    uint8_t palette;
+    signed char offset;
+    uint8_t h08;
+    uint8_t h16;
+    uint8_t wmode;
+    uint8_t* output;
+    uint32_t pitch;
+    uint8_t format;
+    uint32_t colors[256];
+    bool narrow;
+    bool narrowLine[MARIA_SURFACE_HEIGHT];
+    bool skip;
+    bool redraw;
+    // The current zone's display list, decoded from zone
+    maria_object objects[MARIA_OBJECT_COUNT];
+    uint8_t objectCount;
+    uint16_t zone;
+    bool zoneValid;
+    uint8_t zonePageCount;
+    uint8_t zonePage[MARIA_ZONE_PAGES];
+    uint32_t zoneSerial[MARIA_ZONE_PAGES];
+    // The lines of the last frame, by scanline from the top of the display
+    // area. Whether line RAM was built on the last scanline, and whether it
+    // matched what was built there on the last frame or else the first and
+    // last entries that did not.
+    maria_line lines[MARIA_SURFACE_HEIGHT];
+    bool lineStored;
+    bool lineSame;
+    uint8_t lineFirst;
+    uint8_t lineLast;
+    maria_worker* thread;
+} maria_state;
+
 extern void maria_Reset(void);
 extern uint32_t maria_RenderScanline(void);
 extern void maria_Clear(void);
-extern rect maria_displayArea;
-extern rect maria_visibleArea;
-extern uint8_t maria_surface[MARIA_SURFACE_SIZE];
-extern uint16_t maria_scanline;
+extern void maria_SetOutput(void* buffer, uint32_t pitch, uint8_t format);
+extern void maria_LoadPalette(void);
+extern void maria_SetNarrow(bool narrow);
+extern uint16_t maria_GetLineWidth(uint16_t row);
+extern bool maria_IsNarrow(void);
+extern void maria_SetSkip(bool skip);
+extern void maria_SetRedraw(bool redraw);
+extern bool maria_GetRowDamage(uint16_t row, uint16_t* left, uint16_t* right);
+extern bool maria_GetDamage(rect* area);
+extern void maria_ClearMemo(void);
+extern bool maria_SetThreaded(bool threaded);
+extern void maria_Flush(void);
+extern void maria_Release(void);
+
+#define maria_displayArea (prosystem_current->maria.displayArea)
+#define maria_visibleArea (prosystem_current->maria.visibleArea)
+#define maria_surface (prosystem_current->maria.surface)
+#define maria_scanline (prosystem_current->maria.scanline)
 
 #endif
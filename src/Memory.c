@@ -26,27 +26,29 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "Memory.h"
 #include "ExpansionModule.h"
+#include "ProSystem.h"
 
-uint8_t memory_ram[MEMORY_SIZE] = {0};
-uint8_t memory_rom[MEMORY_SIZE] = {0};
+#define memory_readPage (prosystem_current->memory.readPage)
+#define memory_writePage (prosystem_current->memory.writePage)
+#define memory_reader (prosystem_current->memory.reader)
+#define memory_writer (prosystem_current->memory.writer)
+#define memory_pageType (prosystem_current->memory.pageType)
+#define memory_tracked (prosystem_current->memory.tracked)
 
-void memory_Reset(void) {
-    uint32_t index;
-    
-    for (index = 0; index < MEMORY_SIZE; index++) {
-        memory_ram[index] = 0;
-        memory_rom[index] = 1;
-    }
-    
-    for (index = 0; index < 16384; index++) {
-        memory_rom[index] = 0;
-    }
-}
+#define MEMORY_PAGE_RAM 0
+#define MEMORY_PAGE_ROM 1
+#define MEMORY_PAGE_MIXED 2
 
-uint8_t memory_Read(uint16_t address) {
+// Pages from here up may be served straight from the ROM image. Below it the
+// registers, RAM and save states all work on memory_ram, so ROM is copied.
+#define MEMORY_ROM_WINDOW 0x40
+
+// Full decode of the pages that hold registers or bank switched hardware
+static uint8_t memory_ReadDecoded(uint16_t address) {
     uint8_t tmp_uint8_t;
     
     /*if (cartridge_pokey && address == POKEY_RANDOM) {
@@ -72,7 +74,7 @@ uint8_t memory_Read(uint16_t address) {
         case INTIM:
         case INTIM | 0x2:
             memory_ram[INTFLG] &= 0x7f;
-            return memory_ram[INTIM];
+            return riot_GetTimer();
         
         case INTFLG:
         case INTFLG | 0x2:
@@ -81,11 +83,11 @@ uint8_t memory_Read(uint16_t address) {
             return tmp_uint8_t;
         
         default:
-            return memory_ram[address];
+            return memory_Peek(address);
     }
 }
 
-void memory_Write(uint16_t address, uint8_t data) {
+static void memory_WriteDecoded(uint16_t address, uint8_t data) {
     if (cartridge_xm &&
         ((address >= 0x0470 && address < 0x0480) ||
         ((xm_pokey_enabled && (address >= 0x0450 && address < 0x0470)) ||
@@ -108,6 +110,7 @@ void memory_Write(uint16_t address, uint8_t data) {
             case WSYNC:
                 if (!(cartridge_flags & 128)) {
                     memory_ram[WSYNC] = true;
+                    prosystem_Schedule(PROSYSTEM_EVENT_WSYNC, prosystem_cycles);
                 }
                 break;
         
@@ -184,18 +187,23 @@ void memory_Write(uint16_t address, uint8_t data) {
             
             default:
                 memory_ram[address] = data;
+                memory_serial[address >> 8]++;
                 
                 if (address >= 8256 && address <= 8447) {
                     memory_ram[address - 8192] = data;
+                    memory_serial[(address - 8192) >> 8]++;
                 }
                 else if (address >= 8512 && address <= 8702) {
                     memory_ram[address - 8192] = data;
+                    memory_serial[(address - 8192) >> 8]++;
                 }
                 else if (address >= 64 && address <= 255) {
                     memory_ram[address + 8192] = data;
+                    memory_serial[(address + 8192) >> 8]++;
                 }
                 else if (address >= 320 && address <= 511) {
                     memory_ram[address + 8192] = data;
+                    memory_serial[(address + 8192) >> 8]++;
                 }
                 break;
         }
@@ -207,20 +215,217 @@ void memory_Write(uint16_t address, uint8_t data) {
     }
 }
 
+static bool memory_IsDecodedPage(uint8_t page) {
+    // XM control registers and XM pokey
+    if (cartridge_xm && page == 0x04) {
+        return true;
+    }
+    
+    // XM banked RAM
+    if (cartridge_xm && xm_mem_enabled && page >= 0x40 && page < 0x80) {
+        return true;
+    }
+    
+    if (cartridge_pokey) {
+        if (cartridge_pokey450 ? (page == 0x04) : (page == 0x40)) {
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+static void memory_MapPage(uint8_t page) {
+    uint16_t address = page * MEMORY_PAGE_SIZE;
+    
+    sally_MapCode(page, NULL);
+    memory_readPage[page] = memory_page[page];
+    memory_writePage[page] = memory_tracked[page]? NULL: memory_ram + address;
+    memory_reader[page] = memory_ReadDecoded;
+    memory_writer[page] = memory_WriteDecoded;
+    
+    if (memory_IsDecodedPage(page)) {
+        memory_readPage[page] = NULL;
+        memory_writePage[page] = NULL;
+        return;
+    }
+    
+    switch (page) {
+        case 0x00: // TIA, Maria and the mirrored zero page
+        case 0x01: // Mirrored stack
+        case 0x20: // Zero page
+        case 0x21: // Stack
+            memory_writePage[page] = NULL;
+            return;
+        
+        case 0x02: // RIOT
+            memory_readPage[page] = NULL;
+            memory_writePage[page] = NULL;
+            return;
+    }
+    
+    if (memory_pageType[page] == MEMORY_PAGE_ROM) {
+        memory_writePage[page] = NULL;
+        memory_writer[page] = cartridge_Write;
+        
+        // Mapped in place, so the bytes cannot change while it stays mapped
+        if (memory_page[page] != memory_ram + address) {
+            sally_MapCode(page, memory_page[page]);
+        }
+    }
+    else if (memory_pageType[page] == MEMORY_PAGE_MIXED) {
+        memory_writePage[page] = NULL;
+    }
+}
+
+static void memory_ScanPage(uint8_t page) {
+    uint16_t address = page * MEMORY_PAGE_SIZE;
+    uint32_t rom = 0;
+    
+    for (uint32_t index = 0; index < MEMORY_PAGE_SIZE; index++) {
+        rom += memory_rom[address + index] ? 1 : 0;
+    }
+    
+    if (rom == 0) {
+        memory_pageType[page] = MEMORY_PAGE_RAM;
+    }
+    else if (rom == MEMORY_PAGE_SIZE) {
+        memory_pageType[page] = MEMORY_PAGE_ROM;
+    }
+    else {
+        memory_pageType[page] = MEMORY_PAGE_MIXED;
+    }
+    memory_MapPage(page);
+}
+
+// Brings a page that is mapped in place back into memory_ram so it can be
+// changed a byte at a time.
+static void memory_CopyPage(uint8_t page) {
+    // Its bytes are about to change
+    memory_serial[page]++;
+    
+    uint8_t* ram = memory_ram + (page * MEMORY_PAGE_SIZE);
+    if (memory_page[page] != ram) {
+        memcpy(ram, memory_page[page], MEMORY_PAGE_SIZE);
+        memory_page[page] = ram;
+    }
+}
+
+// Rebuilds the page table. Must be called whenever the cartridge type, the
+// POKEY mapping or the XM register changes.
+void memory_MapPages(void) {
+    for (uint32_t page = 0; page < MEMORY_PAGE_COUNT; page++) {
+        memory_MapPage(page);
+    }
+}
+
+void memory_Reset(void) {
+    uint32_t index;
+    
+    for (index = 0; index < MEMORY_SIZE; index++) {
+        memory_ram[index] = 0;
+        memory_rom[index] = 1;
+    }
+    
+    for (index = 0; index < 16384; index++) {
+        memory_rom[index] = 0;
+    }
+    
+    // The ROM images may have been replaced
+    sally_ClearCode();
+    
+    for (index = 0; index < MEMORY_PAGE_COUNT; index++) {
+        memory_page[index] = memory_ram + (index * MEMORY_PAGE_SIZE);
+        memory_tracked[index] = false;
+        memory_serial[index]++;
+        memory_ScanPage(index);
+    }
+}
+
+uint8_t memory_Read(uint16_t address) {
+    const uint8_t* page = memory_readPage[address >> 8];
+    if (page != NULL) {
+        return page[address & 0xff];
+    }
+    return memory_reader[address >> 8](address);
+}
+
+void memory_Write(uint16_t address, uint8_t data) {
+    uint8_t* page = memory_writePage[address >> 8];
+    if (page != NULL) {
+        page[address & 0xff] = data;
+        return;
+    }
+    memory_writer[address >> 8](address, data);
+}
+
+// Maps ROM into the address space. Whole pages in the ROM window point
+// straight at data, so a bank switch only swaps page pointers; data must stay
+// valid while it is mapped. Anything else is copied into memory_ram.
 void memory_WriteROM(uint16_t address, uint32_t size, const uint8_t* data) {
     if ((address + size) <= MEMORY_SIZE && data != NULL) {
-        for (uint32_t index = 0; index < size; index++) {
-            memory_ram[address + index] = data[index];
-            memory_rom[address + index] = 1;
+        uint32_t index = 0;
+        while (index < size) {
+            uint32_t current = address + index;
+            uint8_t page = current / MEMORY_PAGE_SIZE;
+            
+            if (page >= MEMORY_ROM_WINDOW && !(current % MEMORY_PAGE_SIZE) &&
+                (size - index) >= MEMORY_PAGE_SIZE) {
+                if (memory_page[page] != data + index) {
+                    memory_serial[page]++;
+                }
+                memory_page[page] = data + index;
+                if (memory_pageType[page] != MEMORY_PAGE_ROM) {
+                    memset(memory_rom + current, 1, MEMORY_PAGE_SIZE);
+                    memory_pageType[page] = MEMORY_PAGE_ROM;
+                    memory_MapPage(page);
+                }
+                else {
+                    memory_readPage[page] = memory_IsDecodedPage(page) ? NULL : memory_page[page];
+                    sally_MapCode(page, memory_readPage[page]);
+                }
+                index += MEMORY_PAGE_SIZE;
+            }
+            else {
+                memory_CopyPage(page);
+                memory_ram[current] = data[index];
+                memory_rom[current] = 1;
+                index++;
+                if (index == size || !((address + index) % MEMORY_PAGE_SIZE)) {
+                    memory_ScanPage(page);
+                }
+            }
         }
+        
+        // A ROM byte over WSYNC halts the CPU just like a write to it
+        if (address <= WSYNC && (address + size) > WSYNC && memory_ram[WSYNC]) {
+            prosystem_Schedule(PROSYSTEM_EVENT_WSYNC, prosystem_cycles);
+        }
+    }
+}
+
+// Sends the CPU's writes to page down the decoded path from now on, so that
+// memory_serial counts every change to what memory_Peek sees there. The
+// registers at $0000-$02FF are also changed by the hardware behind the CPU's
+// back, and loading a state replaces memory_ram outright, so neither is
+// counted.
+void memory_Track(uint8_t page) {
+    if (!memory_tracked[page]) {
+        memory_tracked[page] = true;
+        memory_writePage[page] = NULL;
     }
 }
 
 void memory_ClearROM(uint16_t address, uint32_t size) {
     if ((address + size) <= MEMORY_SIZE) {
         for (uint32_t index = 0; index < size; index++) {
+            uint8_t page = (address + index) / MEMORY_PAGE_SIZE;
+            memory_CopyPage(page);
             memory_ram[address + index] = 0;
             memory_rom[address + index] = 0;
+            if (index + 1 == size || !((address + index + 1) % MEMORY_PAGE_SIZE)) {
+                memory_ScanPage(page);
+            }
         }
     }
 }
@@ -33,13 +33,46 @@
 #include "Riot.h"
 
 #define MEMORY_SIZE 65536
+#define MEMORY_PAGE_SIZE 256
+#define MEMORY_PAGE_COUNT (MEMORY_SIZE / MEMORY_PAGE_SIZE)
+
+typedef uint8_t (*memory_reader)(uint16_t address);
+typedef void (*memory_writer)(uint16_t address, uint8_t data);
+
+typedef struct MemoryState {
+    uint8_t ram[MEMORY_SIZE];
+    uint8_t rom[MEMORY_SIZE];
+    // What backs each page: memory_ram, or the ROM image mapped there
+    const uint8_t* page[MEMORY_PAGE_COUNT];
+    // Whether each page is all RAM, all ROM or a mix of both
+    uint8_t pageType[MEMORY_PAGE_COUNT];
+    // Per page bus decode. Plain memory pages get a direct pointer, every
+    // other page is NULL there and is served by its handler instead.
+    const uint8_t* readPage[MEMORY_PAGE_COUNT];
+    uint8_t* writePage[MEMORY_PAGE_COUNT];
+    memory_reader reader[MEMORY_PAGE_COUNT];
+    memory_writer writer[MEMORY_PAGE_COUNT];
+    // Pages whose writes are counted in serial, so Maria can tell whether
+    // what it read from them has changed; see memory_Track
+    bool tracked[MEMORY_PAGE_COUNT];
+    uint32_t serial[MEMORY_PAGE_COUNT];
+} memory_state;
 
 extern void memory_Reset(void);
+extern void memory_MapPages(void);
 extern uint8_t memory_Read(uint16_t address);
 extern void memory_Write(uint16_t address, uint8_t data);
 extern void memory_WriteROM(uint16_t address, uint32_t size, const uint8_t* data);
 extern void memory_ClearROM(uint16_t address, uint32_t size);
-extern uint8_t memory_ram[MEMORY_SIZE];
-extern uint8_t memory_rom[MEMORY_SIZE];
+extern void memory_Track(uint8_t page);
+
+#define memory_ram (prosystem_current->memory.ram)
+#define memory_rom (prosystem_current->memory.rom)
+#define memory_page (prosystem_current->memory.page)
+#define memory_serial (prosystem_current->memory.serial)
+
+// Reads a byte as the DMA sees it, without any register side effects.
+// ROM from $4000 up may be mapped in place, so it is not in memory_ram.
+#define memory_Peek(address) (memory_page[(uint16_t)(address) >> 8][(uint16_t)(address) & 0xff])
 
 #endif
@@ -27,9 +27,15 @@
 
 #define PALETTE_SIZE 768
 
+typedef struct PaletteState {
+    uint8_t data[PALETTE_SIZE];
+    bool useDefault;
+} palette_state;
+
 extern void palette_Load(const uint8_t* data);
 extern const char *palette_filename;
-extern uint8_t palette_data[PALETTE_SIZE];
-extern bool palette_default;
+
+#define palette_data (prosystem_current->palette.data)
+#define palette_default (prosystem_current->palette.useDefault)
 
 #endif
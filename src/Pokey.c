@@ -45,6 +45,7 @@
 
 #include "Pokey.h"
 #include "ProSystem.h"
+#include "Sound.h"
 
 #define POKEY_NOTPOLY5 0x80
 #define POKEY_POLY4 0x40
@@ -64,52 +65,51 @@
 #define POKEY_POLY4_SIZE 0x000f
 #define POKEY_POLY5_SIZE 0x001f
 #define POKEY_POLY9_SIZE 0x01ff
-#define POKEY_POLY17_SIZE 0x0001ffff
 #define POKEY_CHANNEL1 0
 #define POKEY_CHANNEL2 1
 #define POKEY_CHANNEL3 2
 #define POKEY_CHANNEL4 3
 #define POKEY_SAMPLE 4
+#define POKEY_DIVIDE_OFF 0x7fffffff
 
 #define SK_RESET 0x03
 
-uint8_t pokey_buffer[POKEY_BUFFER_SIZE] = {0};
-uint32_t pokey_size = (POKEY_BUFFER_SIZE - 512); // 524 previously
+static const uint32_t pokey_frequency = 1787520;
+static const uint8_t pokey_poly04[POKEY_POLY4_SIZE] = {1,1,0,1,1,1,0,0,0,0,1,0,1,0,0};
+static const uint8_t pokey_poly05[POKEY_POLY5_SIZE] = {0,0,1,1,0,0,0,1,1,1,1,0,0,1,0,1,0,1,1,0,1,1,1,0,1,0,0,0,0,0,1};
 
-static uint32_t pokey_frequency = 1787520;
-static uint32_t pokey_sampleRate = 31440;
-static uint32_t pokey_soundCntr = 0;
-static uint8_t pokey_audf[4];
-static uint8_t pokey_audc[4];
-static uint8_t pokey_audctl;
-static uint8_t pokey_output[4];
-static uint8_t pokey_outVol[4];
-static uint8_t pokey_poly04[POKEY_POLY4_SIZE] = {1,1,0,1,1,1,0,0,0,0,1,0,1,0,0};
-static uint8_t pokey_poly05[POKEY_POLY5_SIZE] = {0,0,1,1,0,0,0,1,1,1,1,0,0,1,0,1,0,1,1,0,1,1,1,0,1,0,0,0,0,0,1};
-static uint8_t pokey_poly17[POKEY_POLY17_SIZE];
-static uint32_t pokey_poly17Size;
-static uint32_t pokey_polyAdjust;
-static uint32_t pokey_poly04Cntr;
-static uint32_t pokey_poly05Cntr;
-static uint32_t pokey_poly17Cntr;
-static uint32_t pokey_divideMax[4];
-static uint32_t pokey_divideCount[4];
-static uint32_t pokey_sampleMax;
-static uint32_t pokey_sampleCount[2];
-static uint32_t pokey_baseMultiplier;
+#define pokey_sampleRate (prosystem_current->pokey.sampleRate)
+#define pokey_soundCntr (prosystem_current->pokey.soundCntr)
+#define pokey_audf (prosystem_current->pokey.audf)
+#define pokey_audc (prosystem_current->pokey.audc)
+#define pokey_audctl (prosystem_current->pokey.audctl)
+#define pokey_output (prosystem_current->pokey.output)
+#define pokey_outVol (prosystem_current->pokey.outVol)
+#define pokey_poly17 (prosystem_current->pokey.poly17)
+#define pokey_poly17Size (prosystem_current->pokey.poly17Size)
+#define pokey_seed (prosystem_current->pokey.seed)
+#define pokey_polyAdjust (prosystem_current->pokey.polyAdjust)
+#define pokey_poly04Cntr (prosystem_current->pokey.poly04Cntr)
+#define pokey_poly05Cntr (prosystem_current->pokey.poly05Cntr)
+#define pokey_poly17Cntr (prosystem_current->pokey.poly17Cntr)
+#define pokey_divideMax (prosystem_current->pokey.divideMax)
+#define pokey_divideCount (prosystem_current->pokey.divideCount)
+#define pokey_cycle (prosystem_current->pokey.cycle)
+#define pokey_randomPoly9 (prosystem_current->pokey.randomPoly9)
+#define pokey_baseMultiplier (prosystem_current->pokey.baseMultiplier)
 
-static uint8_t rand9[0x1ff];
-static uint8_t rand17[0x1ffff];
-static uint32_t r9;
-static uint32_t r17;
-static uint8_t SKCTL;
-uint8_t RANDOM;
+#define rand9 (prosystem_current->pokey.rand9)
+#define rand17 (prosystem_current->pokey.rand17)
+#define r9 (prosystem_current->pokey.r9)
+#define r17 (prosystem_current->pokey.r17)
+#define SKCTL (prosystem_current->pokey.skctl)
+#define RANDOM (prosystem_current->pokey.random)
 
-uint8_t POT_input[8] = {228, 228, 228, 228, 228, 228, 228, 228};
-static int pot_scanline;
+#define POT_input (prosystem_current->pokey.potInput)
+#define pot_scanline (prosystem_current->pokey.potScanline)
 
-static unsigned long long random_scanline_counter;
-static unsigned long long prev_random_scanline_counter;
+#define random_scanline_counter (prosystem_current->pokey.randomScanlineCounter)
+#define prev_random_scanline_counter (prosystem_current->pokey.prevRandomScanlineCounter)
 
 static void rand_init(uint8_t *rng, int size, int left, int right, int add) {
     int mask = (1 << size) - 1;
@@ -134,8 +134,11 @@ void pokey_Reset(void) {
     pot_scanline = 0;
     pokey_soundCntr = 0;
     
+    // Each context draws the noise table from its own generator, so one
+    // console's resets don't change what another one hears
     for (int index = 0; index < POKEY_POLY17_SIZE; index++) {
-        pokey_poly17[index] = rand( ) & 1;
+        pokey_seed = pokey_seed * 1103515245 + 12345;
+        pokey_poly17[index] = (pokey_seed >> 16) & 1;
     }
     
     pokey_polyAdjust = 0;
@@ -143,10 +146,7 @@ void pokey_Reset(void) {
     pokey_poly05Cntr = 0;
     pokey_poly17Cntr = 0;
     
-    pokey_sampleMax = ((uint32_t)pokey_frequency << 8) / pokey_sampleRate;
-    
-    pokey_sampleCount[0] = 0;
-    pokey_sampleCount[1] = 0;
+    pokey_cycle = 0;
     
     pokey_poly17Size = POKEY_POLY17_SIZE;
     
@@ -154,7 +154,7 @@ void pokey_Reset(void) {
         pokey_outVol[channel] = 0;
         pokey_output[channel] = 0;
         pokey_divideCount[channel] = 0;
-        pokey_divideMax[channel] = 0x7fffffffL;
+        pokey_divideMax[channel] = POKEY_DIVIDE_OFF;
         pokey_audc[channel] = 0;
         pokey_audf[channel] = 0;
     }
@@ -172,6 +172,7 @@ void pokey_Reset(void) {
     
     SKCTL = SK_RESET;
     RANDOM = 0;
+    pokey_randomPoly9 = false;
     
     r9 = 0;
     r17 = 0;
@@ -191,6 +192,89 @@ void pokey_Scanline(void) {
         pot_scanline++;
 }
 
+static uint8_t pokey_Level(void) {
+    uint8_t level = 0;
+    
+    for (uint8_t channel = POKEY_CHANNEL1; channel <= POKEY_CHANNEL4; channel++) {
+        level += pokey_outVol[channel];
+    }
+    return (level << 2) + 8;
+}
+
+// Hands the current level to Sound.c, as of pokey_cycle on this scanline.
+// Sound times count two samples to a scanline, so 227 cycles to a sample.
+static void pokey_StoreLevel(void) {
+    uint64_t cycle = ((uint64_t)pokey_soundCntr * (CYCLES_PER_SCANLINE >> 1)) + pokey_cycle;
+    sound_Level(&sound_pokey, (uint32_t)((cycle << 16) / (CYCLES_PER_SCANLINE >> 1)), pokey_Level());
+}
+
+// Runs POKEY up to the given cycle of the scanline, going straight from one
+// channel event to the next
+static void pokey_Run(uint32_t cycle) {
+    if (cycle > CYCLES_PER_SCANLINE) {
+        cycle = CYCLES_PER_SCANLINE;
+    }
+    
+    while (pokey_cycle < cycle) {
+        uint8_t nextEvent = POKEY_SAMPLE;
+        uint32_t eventMin = cycle - pokey_cycle;
+        
+        uint8_t channel;
+        
+        for (channel = POKEY_CHANNEL1; channel <= POKEY_CHANNEL4; channel++) {
+            if (pokey_divideCount[channel] <= eventMin) {
+                eventMin = pokey_divideCount[channel];
+                nextEvent = channel;
+            }
+        }
+        
+        for (channel = POKEY_CHANNEL1; channel <= POKEY_CHANNEL4; channel++) {
+            if (pokey_divideMax[channel] != POKEY_DIVIDE_OFF) {
+                pokey_divideCount[channel] -= eventMin;
+            }
+        }
+        
+        pokey_cycle += eventMin;
+        pokey_polyAdjust += eventMin;
+        
+        if (nextEvent == POKEY_SAMPLE) {
+            break;
+        }
+        
+        uint32_t clocks = pokey_polyAdjust >> 2;
+        pokey_poly04Cntr = (pokey_poly04Cntr + clocks) % POKEY_POLY4_SIZE;
+        pokey_poly05Cntr = (pokey_poly05Cntr + clocks) % POKEY_POLY5_SIZE;
+        pokey_poly17Cntr = (pokey_poly17Cntr + clocks) % pokey_poly17Size;
+        pokey_polyAdjust &= 3;
+        pokey_divideCount[nextEvent] += pokey_divideMax[nextEvent];
+        
+        uint8_t outVol = pokey_outVol[nextEvent];
+        
+        if ((pokey_audc[nextEvent] & POKEY_NOTPOLY5) || pokey_poly05[pokey_poly05Cntr]) {
+            if (pokey_audc[nextEvent] & POKEY_PURE) {
+                pokey_output[nextEvent] = !pokey_output[nextEvent];
+            }
+            else if (pokey_audc[nextEvent] & POKEY_POLY4) {
+                pokey_output[nextEvent] = pokey_poly04[pokey_poly04Cntr];
+            }
+            else {
+                pokey_output[nextEvent] = pokey_poly17[pokey_poly17Cntr];
+            }
+        }
+        
+        if (pokey_output[nextEvent]) {
+            pokey_outVol[nextEvent] = pokey_audc[nextEvent] & POKEY_VOLUME_MASK;
+        }
+        else {
+            pokey_outVol[nextEvent] = 0;
+        }
+        
+        if (pokey_outVol[nextEvent] != outVol) {
+            pokey_StoreLevel();
+        }
+    }
+}
+
 uint8_t pokey_GetRegister(uint16_t address) {
     uint8_t data = 0;
     
@@ -223,7 +307,7 @@ uint8_t pokey_GetRegister(uint16_t address) {
                 r9 = 0;
                 r17 = 0;
             }
-            if (pokey_audctl & POKEY_POLY9) {
+            if (pokey_randomPoly9) {
                 RANDOM = rand9[r9];
             }
             else {
@@ -240,9 +324,10 @@ uint8_t pokey_GetRegister(uint16_t address) {
     return data;
 }
 
+// The pots and RANDOM are read back by the CPU, so what they depend on is
+// kept here. Audio writes go through Sound.c, which may apply them later
+// on its own thread.
 void pokey_SetRegister(uint16_t address, uint8_t value) {
-    uint8_t channelMask;
-    
     switch (address) {
         case POKEY_POTGO:
             if (!(SKCTL & 4))
@@ -256,6 +341,21 @@ void pokey_SetRegister(uint16_t address, uint8_t value) {
                 pot_scanline = 228;
             return;
         
+        case POKEY_AUDCTL:
+            pokey_randomPoly9 = (value & POKEY_POLY9) != 0;
+            break;
+    }
+    
+    sound_Write(SOUND_WRITE_POKEY, address, value);
+}
+
+// Writes take effect at the given cycle of the scanline
+void pokey_Write(uint16_t address, uint8_t value, uint32_t cycle) {
+    uint8_t channelMask;
+    
+    pokey_Run(cycle);
+    
+    switch (address) {
         case POKEY_AUDF1:
             pokey_audf[POKEY_CHANNEL1] = value;
             channelMask = 1 << POKEY_CHANNEL1;
@@ -330,10 +430,10 @@ void pokey_SetRegister(uint16_t address, uint8_t value) {
     
     if (channelMask & (1 << POKEY_CHANNEL1)) {
         if (pokey_audctl & POKEY_CH1_179) {
-            newValue = pokey_audf[POKEY_CHANNEL1] + 4;
+            newValue = (pokey_audf[POKEY_CHANNEL1] + 4) << 2;
         }
         else {
-            newValue = (pokey_audf[POKEY_CHANNEL1] + 1) * pokey_baseMultiplier;
+            newValue = ((pokey_audf[POKEY_CHANNEL1] + 1) * pokey_baseMultiplier) << 2;
         }
         
         if (newValue != pokey_divideMax[POKEY_CHANNEL1]) {
@@ -347,14 +447,14 @@ void pokey_SetRegister(uint16_t address, uint8_t value) {
     if (channelMask & (1 << POKEY_CHANNEL2)) {
         if (pokey_audctl & POKEY_CH1_CH2) {
             if (pokey_audctl & POKEY_CH1_179) {
-                newValue = pokey_audf[POKEY_CHANNEL2] * 256 + pokey_audf[POKEY_CHANNEL1] + 7;
+                newValue = (pokey_audf[POKEY_CHANNEL2] * 256 + pokey_audf[POKEY_CHANNEL1] + 7) << 2;
             }
             else {
-                newValue = (pokey_audf[POKEY_CHANNEL2] * 256 + pokey_audf[POKEY_CHANNEL1] + 1) * pokey_baseMultiplier;
+                newValue = ((pokey_audf[POKEY_CHANNEL2] * 256 + pokey_audf[POKEY_CHANNEL1] + 1) * pokey_baseMultiplier) << 2;
             }
         }
         else {
-            newValue = (pokey_audf[POKEY_CHANNEL2] + 1) * pokey_baseMultiplier;
+            newValue = ((pokey_audf[POKEY_CHANNEL2] + 1) * pokey_baseMultiplier) << 2;
         }
         if (newValue != pokey_divideMax[POKEY_CHANNEL2]) {
             pokey_divideMax[POKEY_CHANNEL2] = newValue;
@@ -366,10 +466,10 @@ void pokey_SetRegister(uint16_t address, uint8_t value) {
     
     if (channelMask & (1 << POKEY_CHANNEL3)) {
         if (pokey_audctl & POKEY_CH3_179) {
-            newValue = pokey_audf[POKEY_CHANNEL3] + 4;
+            newValue = (pokey_audf[POKEY_CHANNEL3] + 4) << 2;
         }
         else {
-            newValue= (pokey_audf[POKEY_CHANNEL3] + 1) * pokey_baseMultiplier;
+            newValue = ((pokey_audf[POKEY_CHANNEL3] + 1) * pokey_baseMultiplier) << 2;
         }
         
         if (newValue!= pokey_divideMax[POKEY_CHANNEL3]) {
@@ -384,14 +484,14 @@ void pokey_SetRegister(uint16_t address, uint8_t value) {
     if (channelMask & (1 << POKEY_CHANNEL4)) {
         if (pokey_audctl & POKEY_CH3_CH4) {
             if (pokey_audctl & POKEY_CH3_179) {
-                newValue = pokey_audf[POKEY_CHANNEL4] * 256 + pokey_audf[POKEY_CHANNEL3] + 7;
+                newValue = (pokey_audf[POKEY_CHANNEL4] * 256 + pokey_audf[POKEY_CHANNEL3] + 7) << 2;
             }
             else {
-                newValue = (pokey_audf[POKEY_CHANNEL4] * 256 + pokey_audf[POKEY_CHANNEL3] + 1) * pokey_baseMultiplier;
+                newValue = ((pokey_audf[POKEY_CHANNEL4] * 256 + pokey_audf[POKEY_CHANNEL3] + 1) * pokey_baseMultiplier) << 2;
             }
         }
         else {
-            newValue = (pokey_audf[POKEY_CHANNEL4] + 1) * pokey_baseMultiplier;
+            newValue = ((pokey_audf[POKEY_CHANNEL4] + 1) * pokey_baseMultiplier) << 2;
         }
         
         if (newValue != pokey_divideMax[POKEY_CHANNEL4]) {
@@ -403,90 +503,40 @@ void pokey_SetRegister(uint16_t address, uint8_t value) {
         }
     }
     
+    // Channels toggling faster than the output can carry are held still
+    uint32_t rate = sound_GetSampleRate();
+    uint32_t minimum = (rate != 0)? ((pokey_frequency << 2) / rate): 0;
+    
     for (uint8_t channel = POKEY_CHANNEL1; channel <= POKEY_CHANNEL4; channel++) {
         if (channelMask & (1 << channel)) {
             if ((pokey_audc[channel] & POKEY_VOLUME_ONLY) ||
                 ((pokey_audc[channel] & POKEY_VOLUME_MASK) == 0) ||
-                (pokey_divideMax[channel] < (pokey_sampleMax >> 8))) {
+                (pokey_divideMax[channel] < minimum)) {
 #if 1 // WII
                 pokey_outVol[channel] = 1;
 #else
                 pokey_outVol[channel] = pokey_audc[channel] & POKEY_VOLUME_MASK;
 #endif
-                pokey_divideCount[channel] = 0x7fffffff;
-                pokey_divideMax[channel] = 0x7fffffff;
+                pokey_divideCount[channel] = POKEY_DIVIDE_OFF;
+                pokey_divideMax[channel] = POKEY_DIVIDE_OFF;
             }
         }
     }
+    
+    if (channelMask) {
+        pokey_StoreLevel();
+    }
 }
 
+// Runs POKEY to the end of the scanline, storing length samples of it
 void pokey_Process(uint32_t length) {
-    uint8_t* buffer = pokey_buffer + pokey_soundCntr;
-    uint32_t* sampleCntrPtr = (uint32_t*)((uint8_t*)(&pokey_sampleCount[0]) + 1);
-    uint32_t size = length;
-    
-    while(length) {
-        uint8_t currentValue;
-        uint8_t nextEvent = POKEY_SAMPLE;
-        uint32_t eventMin = *sampleCntrPtr;
-        
-        uint8_t channel;
-        
-        for (channel = POKEY_CHANNEL1; channel <= POKEY_CHANNEL4; channel++) {
-            if (pokey_divideCount[channel] <= eventMin) {
-                eventMin = pokey_divideCount[channel];
-                nextEvent = channel;
-            }
-        }
-        
-        for(channel = POKEY_CHANNEL1; channel <= POKEY_CHANNEL4; channel++) {
-            pokey_divideCount[channel] -= eventMin;
-        }
-        
-        *sampleCntrPtr -= eventMin;
-        pokey_polyAdjust += eventMin;
-        
-        if (nextEvent != POKEY_SAMPLE) {
-            pokey_poly04Cntr = (pokey_poly04Cntr + pokey_polyAdjust) % POKEY_POLY4_SIZE;
-            pokey_poly05Cntr = (pokey_poly05Cntr + pokey_polyAdjust) % POKEY_POLY5_SIZE;
-            pokey_poly17Cntr = (pokey_poly17Cntr + pokey_polyAdjust) % pokey_poly17Size;
-            pokey_polyAdjust = 0;
-            pokey_divideCount[nextEvent] += pokey_divideMax[nextEvent];
-            
-            if ((pokey_audc[nextEvent] & POKEY_NOTPOLY5) || pokey_poly05[pokey_poly05Cntr]) {
-                if (pokey_audc[nextEvent] & POKEY_PURE) {
-                    pokey_output[nextEvent] = !pokey_output[nextEvent];
-                }
-                else if (pokey_audc[nextEvent] & POKEY_POLY4) {
-                    pokey_output[nextEvent] = pokey_poly04[pokey_poly04Cntr];
-                }
-                else {
-                    pokey_output[nextEvent] = pokey_poly17[pokey_poly17Cntr];
-                }
-            }
-            
-            if (pokey_output[nextEvent]) {
-                pokey_outVol[nextEvent] = pokey_audc[nextEvent] & POKEY_VOLUME_MASK;
-            }
-            else {
-                pokey_outVol[nextEvent] = 0;
-            }
-        }
-        else {
-            *pokey_sampleCount += pokey_sampleMax;
-            currentValue = 0;
-            
-            for (channel = POKEY_CHANNEL1; channel <= POKEY_CHANNEL4; channel++) {
-                currentValue += pokey_outVol[channel];
-            }
-            
-            currentValue = (currentValue << 2) + 8;
-            *buffer++ = currentValue;
-            length--;
-        }
+    for (uint32_t index = 0; index < length; index++) {
+        pokey_Run((CYCLES_PER_SCANLINE * (index + 1)) / length);
+        pokey_buffer[pokey_soundCntr + index] = pokey_Level();
     }
     
-    pokey_soundCntr += size;
+    pokey_cycle -= CYCLES_PER_SCANLINE;
+    pokey_soundCntr += length;
     
     if (pokey_soundCntr >= pokey_size) {
         pokey_soundCntr = 0;
@@ -74,13 +74,51 @@
 #define POKEY_IRQST 0x400e
 #define POKEY_SKSTAT 0x400f
 
+#define POKEY_POLY17_SIZE 0x0001ffff
+
+typedef struct PokeyState {
+    uint8_t buffer[POKEY_BUFFER_SIZE];
+    uint32_t size;
+    uint32_t sampleRate;
+    uint32_t soundCntr;
+    uint8_t audf[4];
+    uint8_t audc[4];
+    uint8_t audctl;
+    uint8_t output[4];
+    uint8_t outVol[4];
+    uint8_t poly17[POKEY_POLY17_SIZE];
+    uint32_t seed;
+    uint32_t poly17Size;
+    uint32_t polyAdjust;
+    uint32_t poly04Cntr;
+    uint32_t poly05Cntr;
+    uint32_t poly17Cntr;
+    uint32_t divideMax[4];
+    uint32_t divideCount[4];
+    uint32_t cycle;
+    uint32_t baseMultiplier;
+    uint8_t rand9[0x1ff];
+    uint8_t rand17[0x1ffff];
+    uint32_t r9;
+    uint32_t r17;
+    uint8_t skctl;
+    uint8_t random;
+    bool randomPoly9;
+    uint8_t potInput[8];
+    int potScanline;
+    unsigned long long randomScanlineCounter;
+    unsigned long long prevRandomScanlineCounter;
+} pokey_state;
+
 extern void pokey_Reset(void);
 extern void pokey_SetRegister(uint16_t address, uint8_t value);
+extern void pokey_Write(uint16_t address, uint8_t value, uint32_t cycle);
 extern uint8_t pokey_GetRegister(uint16_t address);
 extern void pokey_Process(uint32_t length);
 extern void pokey_Clear(void);
-extern uint8_t pokey_buffer[POKEY_BUFFER_SIZE];
-extern uint32_t pokey_size;
+
+#define pokey_buffer (prosystem_current->pokey.buffer)
+#define pokey_size (prosystem_current->pokey.size)
 
 extern void pokey_Frame(void);
 extern void pokey_Scanline(void);
@@ -26,28 +26,56 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "ProSystem.h"
 #define PRO_SYSTEM_STATE_HEADER "PRO-SYSTEM STATE"
 #define PRO_SYSTEM_SOURCE "ProSystem.c"
 
-bool prosystem_active = false;
-bool prosystem_paused = false;
-uint16_t prosystem_frequency = 60;
-uint8_t prosystem_frame = 0;
-uint16_t prosystem_scanlines = 262;
-uint32_t prosystem_cycles = 0;
-uint32_t prosystem_extra_cycles = 0;
-int lightgun_scanline = 0;
-float lightgun_cycle = 0;
+// Every context starts out as a copy of these
+static const prosystem_context prosystem_contextDefaults = {
+    .frequency = 60,
+    .scanlines = 262,
+    .regionType = REGION_AUTO,
+    .cartridge = { .left_switch = 1, .hblank = HBLANK_DEFAULT },
+    .database = { .enabled = true },
+    .maria = {
+        .displayArea = {0, 16, 319, 258},
+        .visibleArea = {0, 26, 319, 248},
+        .scanline = 1
+    },
+    .palette = { .useDefault = true },
+    .riot = { .timer = TIM64T },
+    .tia = { .size = TIA_BUFFER_SIZE },
+    .pokey = {
+        .size = POKEY_BUFFER_SIZE - 512,
+        .sampleRate = 31440,
+        .potInput = {228, 228, 228, 228, 228, 228, 228, 228},
+        .seed = 1
+    },
+    .sound = { .samplesPerSec = 48000 }
+};
 
-// Whether the last CPU operation resulted in a half cycle (need to take it
-// into consideration)
-extern bool half_cycle;
+// Filled in from prosystem_contextDefaults before main runs, rather than
+// from a second initializer that would put another full context in the image.
+static prosystem_context prosystem_defaultContext;
+PROSYSTEM_THREAD_LOCAL prosystem_context *prosystem_current = &prosystem_defaultContext;
+
+#if defined(_MSC_VER)
+static void prosystem_InitDefaultContext(void);
+#pragma section(".CRT$XCU", read)
+__declspec(allocate(".CRT$XCU")) static void (*prosystem_initDefaultContext)(void) = prosystem_InitDefaultContext;
+#else
+__attribute__((constructor))
+#endif
+static void prosystem_InitDefaultContext(void) {
+    prosystem_defaultContext = prosystem_contextDefaults;
+}
 
 void prosystem_Reset(void) {
     if (cartridge_IsLoaded()) {
+        sound_Flush();
         prosystem_paused = false;
         prosystem_frame = 0;
         sally_Reset();
@@ -56,6 +84,7 @@ void prosystem_Reset(void) {
         tia_Reset();
         pokey_Clear();
         pokey_Reset();
+        sound_Reset();
         xm_Reset();
         memory_Reset();
         maria_Clear();
@@ -86,10 +115,102 @@ static void prosystem_FireLightGun(void) {
     }
 }
 
-void prosystem_ExecuteFrame(const uint8_t* input) {
-    // Is WSYNC enabled for the current frame?
-    bool wsync = !(cartridge_flags & CARTRIDGE_WSYNC_MASK);
+// Strobe now, and queue the strobe for when the beam reaches the lightgun
+// if that happens later in this scanline
+static void prosystem_ScheduleLightGun(void) {
+    prosystem_FireLightGun();
+    
+    if ((maria_scanline >= lightgun_scanline) &&
+        (maria_scanline <= (lightgun_scanline + 3)) &&
+        (int)prosystem_cycles < ((int)lightgun_cycle) - 1) {
+        prosystem_Schedule(PROSYSTEM_EVENT_LIGHTGUN, ((int)lightgun_cycle) - 1);
+    }
+}
+
+void prosystem_Schedule(uint8_t event, uint32_t cycle) {
+    prosystem_events[event] = cycle;
+    
+    if (cycle < prosystem_next_event) {
+        prosystem_next_event = cycle;
+        
+        // The CPU may be in the middle of a run that ends later
+        sally_Stop();
+    }
+}
+
+// Schedules an event against prosystem_clock. Half cycles only ever make
+// prosystem_cycles run ahead of the clock, so this may fire early, in which
+// case the handler simply schedules itself again.
+void prosystem_ScheduleClock(uint8_t event, uint32_t clock) {
+    int32_t delta = (int32_t)(clock - prosystem_clock);
+    prosystem_Schedule(event, (delta > 0)? prosystem_cycles + ((uint32_t)delta << 2): prosystem_cycles);
+}
+
+// Fires every event that has come due. Returns true when the CPU has to stop
+// for the rest of the scanline.
+static bool prosystem_Dispatch(void) {
+    bool halt = false;
+    uint32_t next = PROSYSTEM_EVENT_NONE;
+    
+    for (int event = 0; event < PROSYSTEM_EVENT_COUNT; event++) {
+        uint32_t cycle = prosystem_events[event];
+        
+        if (cycle > prosystem_cycles) {
+            if (cycle < next) {
+                next = cycle;
+            }
+            continue;
+        }
+        
+        prosystem_events[event] = PROSYSTEM_EVENT_NONE;
+        
+        switch (event) {
+            case PROSYSTEM_EVENT_TIMER:
+                riot_UpdateTimer();
+                break;
+                
+            case PROSYSTEM_EVENT_LIGHTGUN:
+                prosystem_FireLightGun();
+                break;
+                
+            case PROSYSTEM_EVENT_WSYNC:
+                if (memory_ram[WSYNC] && !(cartridge_flags & CARTRIDGE_WSYNC_MASK)) {
+                    memory_ram[WSYNC] = false;
+                    halt = true;
+                }
+                break;
+        }
+    }
+    
+    // Handlers may have queued further events
+    for (int event = 0; event < PROSYSTEM_EVENT_COUNT; event++) {
+        if (prosystem_events[event] < next) {
+            next = prosystem_events[event];
+        }
+    }
+    prosystem_next_event = next;
     
+    return halt;
+}
+
+// Runs the CPU until the given cycle, only stopping in between for events
+// that come due. Returns true if the CPU was halted by a WSYNC.
+static bool prosystem_Run(uint32_t limit) {
+    while (prosystem_cycles < limit) {
+        uint32_t until = (prosystem_next_event < limit)? prosystem_next_event: limit;
+        
+        // Always at least one instruction: events are only looked at
+        // between instructions
+        sally_Run((until > prosystem_cycles)? until - prosystem_cycles: 0);
+        
+        if (prosystem_cycles >= prosystem_next_event && prosystem_Dispatch()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void prosystem_ExecuteFrame(const uint8_t* input) {
     // Is Maria cycle stealing enabled for the current frame?
     bool cycle_stealing = !(cartridge_flags & CARTRIDGE_CYCLE_STEALING_MASK);
     
@@ -110,9 +231,6 @@ void prosystem_ExecuteFrame(const uint8_t* input) {
             memory_ram[MSTAT] = 128;
         }
         
-        // Was a WSYNC performed withing the current scanline?
-        bool wsync_scanline = false;
-        
         uint32_t cycles = 0;
         
         if (!cycle_stealing || (memory_ram[CTRL] & 96 ) != 64) {
@@ -128,64 +246,57 @@ void prosystem_ExecuteFrame(const uint8_t* input) {
             prosystem_cycles = 0;
         }
         
-        // If lightgun is enabled, check to see if it should be fired
-        if (lightgun) prosystem_FireLightGun();
+        // Event times are per scanline, so the queue is rebuilt each line
+        for (int event = 0; event < PROSYSTEM_EVENT_COUNT; event++) {
+            prosystem_events[event] = PROSYSTEM_EVENT_NONE;
+        }
+        prosystem_next_event = PROSYSTEM_EVENT_NONE;
         
-        while (prosystem_cycles < cartridge_hblank) {
-            cycles = sally_ExecuteInstruction( );
-            prosystem_cycles += (cycles << 2);
-            
-            if (half_cycle) prosystem_cycles += 2;
-            
-            if (riot_timing) {
-                riot_UpdateTimer(cycles);
-            }
-            
-            // If lightgun is enabled, check to see if it should be fired
-            if (lightgun) prosystem_FireLightGun();
-            
-            if (memory_ram[WSYNC] && wsync) {
-                memory_ram[WSYNC] = false;
-                wsync_scanline = true;
-                break;
-            }
+        if (riot_timing) {
+            prosystem_ScheduleClock(PROSYSTEM_EVENT_TIMER, riot_event);
         }
         
+        // WSYNC may have been left set by a reset or a loaded state
+        if (memory_ram[WSYNC]) {
+            prosystem_Schedule(PROSYSTEM_EVENT_WSYNC, prosystem_cycles);
+        }
+        
+        // If lightgun is enabled, check to see if it should be fired
+        if (lightgun) prosystem_ScheduleLightGun();
+        
+        // Was a WSYNC performed withing the current scanline?
+        bool wsync_scanline = prosystem_Run(cartridge_hblank);
+        
         cycles = maria_RenderScanline( );
         
         if (cycle_stealing) {
             prosystem_cycles += cycles;
+            prosystem_clock += cycles >> 2;
         
             if(riot_timing) {
-                riot_UpdateTimer(cycles >> 2);
+                riot_UpdateTimer();
             }
         }
         
-        while (!wsync_scanline && prosystem_cycles < CYCLES_PER_SCANLINE) {
-            cycles = sally_ExecuteInstruction();
-            prosystem_cycles += (cycles << 2);
-            
-            if(half_cycle) prosystem_cycles += 2;
-            
-            // If lightgun is enabled, check to see if it should be fired
-            if (lightgun) prosystem_FireLightGun();
-            
-            if (riot_timing) {
-                riot_UpdateTimer(cycles);
-            }
-            
-            if(memory_ram[WSYNC] && wsync) {
-                memory_ram[WSYNC] = false;
-                wsync_scanline = true;
-                break;
-            }
+        // Maria raises its NMIs while fetching the display list; the CPU
+        // takes them once DMA is over. A one-line zone at the top of the
+        // display can raise two on the same line.
+        while (prosystem_nmis > 0) {
+            prosystem_nmis--;
+            sally_ExecuteNMI();
+        }
+        
+        if (!wsync_scanline) {
+            wsync_scanline = prosystem_Run(CYCLES_PER_SCANLINE);
         }
         
         // If a WSYNC was performed and the current cycle count is less than
         // the cycles per scanline, add those cycles to current timers.
         if (wsync_scanline && prosystem_cycles < CYCLES_PER_SCANLINE) {
+            prosystem_clock += (CYCLES_PER_SCANLINE - prosystem_cycles) >> 2;
+            
             if (riot_timing) {
-                riot_UpdateTimer((CYCLES_PER_SCANLINE - prosystem_cycles) >> 2);
+                riot_UpdateTimer();
             }
             prosystem_cycles = CYCLES_PER_SCANLINE;
         }
@@ -193,15 +304,19 @@ void prosystem_ExecuteFrame(const uint8_t* input) {
         // If lightgun is enabled, check to see if it should be fired
         if (lightgun) prosystem_FireLightGun();
         
-        tia_Process(2);
-        
-        if (cartridge_pokey || cartridge_xm) {
-            pokey_Process(2);
-        }
+        sound_Scanline(cartridge_pokey || cartridge_xm);
         
         if (cartridge_pokey || cartridge_xm) pokey_Scanline();
     }
     
+    // INTIM is computed on read; leave memory consistent for save states
+    riot_StoreTimer();
+    
+    // Lines may still be being drawn on Maria's thread. The frame's audio
+    // can finish on its own until sound_Store.
+    maria_Flush();
+    sound_EndFrame();
+    
     prosystem_frame++;
     
     if (prosystem_frame >= prosystem_frequency) {
@@ -235,7 +350,7 @@ bool prosystem_Save(const char *filename) {
     loc_buffer[size++] = sally_a;
     loc_buffer[size++] = sally_x;
     loc_buffer[size++] = sally_y;
-    loc_buffer[size++] = sally_p;
+    loc_buffer[size++] = sally_GetStatus();
     loc_buffer[size++] = sally_s;
     loc_buffer[size++] = sally_pc.b.l;
     loc_buffer[size++] = sally_pc.b.h;
@@ -315,7 +430,7 @@ bool prosystem_Save_buffer(uint8_t *buffer) {
     buffer[size++] = sally_a;
     buffer[size++] = sally_x;
     buffer[size++] = sally_y;
-    buffer[size++] = sally_p;
+    buffer[size++] = sally_GetStatus();
     buffer[size++] = sally_s;
     buffer[size++] = sally_pc.b.l;
     buffer[size++] = sally_pc.b.h;
@@ -426,7 +541,7 @@ bool prosystem_Load(const char *filename) {
     sally_a = loc_buffer[offset++];
     sally_x = loc_buffer[offset++];
     sally_y = loc_buffer[offset++];
-    sally_p = loc_buffer[offset++];
+    sally_SetStatus(loc_buffer[offset++]);
     sally_s = loc_buffer[offset++];
     sally_pc.b.l = loc_buffer[offset++];
     sally_pc.b.h = loc_buffer[offset++];
@@ -451,6 +566,9 @@ bool prosystem_Load(const char *filename) {
         offset += 16384;
     }
     
+    // The RAM was replaced behind the memory map's back
+    maria_ClearMemo();
+    
     if (size == 16453 || /* no supercart ram */
         size == 32837 || /* supercart ram */
         size == (16453 + 4 + XM_RAM_SIZE) || /* xm, no supercart ram */
@@ -464,6 +582,7 @@ bool prosystem_Load(const char *filename) {
         riot_intervals = loc_buffer[offset++];
         riot_clocks = ( loc_buffer[offset++] << 8 );
         riot_clocks |= loc_buffer[offset++];
+        riot_Restore();
     }
     
     // XM (if applicable)
@@ -480,6 +599,7 @@ bool prosystem_Load(const char *filename) {
         for (index = 0; index < XM_RAM_SIZE; index++) {
             xm_ram[index] = loc_buffer[offset++];
         }
+        memory_MapPages();
     }
     
     return true;
@@ -521,7 +641,7 @@ bool prosystem_Load_buffer(const uint8_t *buffer) {
     sally_a = buffer[offset++];
     sally_x = buffer[offset++];
     sally_y = buffer[offset++];
-    sally_p = buffer[offset++];
+    sally_SetStatus(buffer[offset++]);
     sally_s = buffer[offset++];
     sally_pc.b.l = buffer[offset++];
     sally_pc.b.h = buffer[offset++];
@@ -545,6 +665,9 @@ bool prosystem_Load_buffer(const uint8_t *buffer) {
         offset += 16384;
     }
     
+    // The RAM was replaced behind the memory map's back
+    maria_ClearMemo();
+    
     if (size == 16453 || /* no supercart ram */
         size == 32837 || /* supercart ram */
         size == (16453 + 4 + XM_RAM_SIZE) || /* xm, no supercart ram */
@@ -558,6 +681,7 @@ bool prosystem_Load_buffer(const uint8_t *buffer) {
         riot_intervals = buffer[offset++];
         riot_clocks = ( buffer[offset++] << 8 );
         riot_clocks |= buffer[offset++];
+        riot_Restore();
     }
     
     // XM (if applicable)
@@ -574,6 +698,7 @@ bool prosystem_Load_buffer(const uint8_t *buffer) {
         for (index = 0; index < XM_RAM_SIZE; index++) {
             xm_ram[index] = buffer[offset++];
         }
+        memory_MapPages();
     }
     
     return true;
@@ -592,6 +717,89 @@ void prosystem_Close(void) {
     maria_Reset();
     maria_Clear();
     memory_Reset();
+    sound_Flush();
     tia_Reset();
     tia_Clear();
+    sound_Reset();
+}
+
+prosystem_context* prosystem_CreateContext(void) {
+    prosystem_context *context = (prosystem_context*)malloc(sizeof(prosystem_context));
+    if (context == NULL) {
+        return NULL;
+    }
+    
+    *context = prosystem_contextDefaults;
+    
+    return context;
+}
+
+void prosystem_DestroyContext(prosystem_context *context) {
+    if (context == NULL || context == &prosystem_defaultContext) {
+        return;
+    }
+    
+    prosystem_context *previous = prosystem_current;
+    prosystem_current = context;
+    cartridge_Release();
+    bios_Release();
+    sally_Release();
+    maria_Release();
+    sound_Release();
+    prosystem_current = (previous == context) ? &prosystem_defaultContext : previous;
+    free(context);
+}
+
+void prosystem_SetContext(prosystem_context *context) {
+    prosystem_current = (context != NULL) ? context : &prosystem_defaultContext;
+}
+
+prosystem_context* prosystem_GetContext(void) {
+    return prosystem_current;
+}
+
+void prosystem_Reset_context(prosystem_context *context) {
+    prosystem_context *previous = prosystem_current;
+    prosystem_current = context;
+    prosystem_Reset();
+    prosystem_current = previous;
+}
+
+void prosystem_ExecuteFrame_context(prosystem_context *context, const uint8_t* input) {
+    prosystem_context *previous = prosystem_current;
+    prosystem_current = context;
+    prosystem_ExecuteFrame(input);
+    prosystem_current = previous;
+}
+
+bool prosystem_Save_context(prosystem_context *context, const char *filename) {
+    prosystem_context *previous = prosystem_current;
+    prosystem_current = context;
+    bool result = prosystem_Save(filename);
+    prosystem_current = previous;
+    return result;
+}
+
+bool prosystem_Load_context(prosystem_context *context, const char *filename) {
+    prosystem_context *previous = prosystem_current;
+    prosystem_current = context;
+    bool result = prosystem_Load(filename);
+    prosystem_current = previous;
+    return result;
+}
+
+bool prosystem_Save_buffer_context(prosystem_context *context, uint8_t *buffer) {
+    prosystem_context *previous = prosystem_current;
+    prosystem_current = context;
+    bool result = prosystem_Save_buffer(buffer);
+    prosystem_current = previous;
+    return result;
+}
+
+bool prosystem_Load_buffer_context(prosystem_context *context, const uint8_t *buffer) {
+    prosystem_context *previous = prosystem_current;
+    prosystem_current = context;
+    bool result = prosystem_Load_buffer(buffer);
+    prosystem_current = previous;
+    return result;
 }
@@ -37,6 +37,65 @@
 #include "Tia.h"
 #include "Pokey.h"
 #include "ExpansionModule.h"
+#include "Database.h"
+#include "Palette.h"
+#include "Sound.h"
+
+// Timed events the frame loop stops the CPU for, between the DMA start and
+// end of line bounds. Times are in the same units as prosystem_cycles and
+// are relative to the current scanline.
+#define PROSYSTEM_EVENT_WSYNC 0
+#define PROSYSTEM_EVENT_TIMER 1
+#define PROSYSTEM_EVENT_LIGHTGUN 2
+#define PROSYSTEM_EVENT_COUNT 3
+#define PROSYSTEM_EVENT_NONE UINT32_MAX
+
+#if defined(_MSC_VER)
+#define PROSYSTEM_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+#define PROSYSTEM_THREAD_LOCAL __thread
+#else
+#define PROSYSTEM_THREAD_LOCAL _Thread_local
+#endif
+
+// All of the state of one emulated console. Every module reaches its state
+// through prosystem_current, which is bound per thread, so several consoles
+// can run side by side as long as each thread drives its own context.
+typedef struct ProSystemContext {
+    bool active;
+    bool paused;
+    uint16_t frequency;
+    uint8_t frame;
+    uint16_t scanlines;
+    uint32_t cycles;
+    uint32_t extraCycles;
+    uint32_t clock;
+    uint32_t events[PROSYSTEM_EVENT_COUNT];
+    uint32_t nextEvent;
+    uint8_t nmis;
+    int lightgunScanline;
+    float lightgunCycle;
+    uint8_t regionType;
+    bios_state bios;
+    cartridge_state cartridge;
+    database_state database;
+    memory_state memory;
+    sally_state sally;
+    maria_state maria;
+    palette_state palette;
+    riot_state riot;
+    tia_state tia;
+    pokey_state pokey;
+    xm_state xm;
+    sound_state sound;
+} prosystem_context;
+
+extern PROSYSTEM_THREAD_LOCAL prosystem_context *prosystem_current;
+
+extern prosystem_context* prosystem_CreateContext(void);
+extern void prosystem_DestroyContext(prosystem_context *context);
+extern void prosystem_SetContext(prosystem_context *context);
+extern prosystem_context* prosystem_GetContext(void);
 
 extern void prosystem_Reset(void);
 extern void prosystem_ExecuteFrame(const uint8_t* input);
@@ -46,6 +105,15 @@ extern bool prosystem_Save_buffer(uint8_t *buffer);
 extern bool prosystem_Load_buffer(const uint8_t *buffer);
 extern void prosystem_Pause(bool pause);
 extern void prosystem_Close(void);
+extern void prosystem_Schedule(uint8_t event, uint32_t cycle);
+extern void prosystem_ScheduleClock(uint8_t event, uint32_t clock);
+
+extern void prosystem_Reset_context(prosystem_context *context);
+extern void prosystem_ExecuteFrame_context(prosystem_context *context, const uint8_t* input);
+extern bool prosystem_Save_context(prosystem_context *context, const char *filename);
+extern bool prosystem_Load_context(prosystem_context *context, const char *filename);
+extern bool prosystem_Save_buffer_context(prosystem_context *context, uint8_t *buffer);
+extern bool prosystem_Load_buffer_context(prosystem_context *context, const uint8_t *buffer);
 
 // The number of cycles per scan line
 #define CYCLES_PER_SCANLINE 454
@@ -56,18 +124,24 @@ extern void prosystem_Close(void);
 // The number of cycles indented (after HBLANK) prior to checking for a hit
 #define LG_CYCLES_INDENT 52
 
-extern bool prosystem_active;
-extern bool prosystem_paused;
-extern uint16_t prosystem_frequency;
-extern uint8_t prosystem_frame;
-extern uint16_t prosystem_scanlines;
-extern uint32_t prosystem_cycles;
-extern uint32_t prosystem_extra_cycles;
+#define prosystem_active (prosystem_current->active)
+#define prosystem_paused (prosystem_current->paused)
+#define prosystem_frequency (prosystem_current->frequency)
+#define prosystem_frame (prosystem_current->frame)
+#define prosystem_scanlines (prosystem_current->scanlines)
+#define prosystem_cycles (prosystem_current->cycles)
+#define prosystem_extra_cycles (prosystem_current->extraCycles)
+// CPU cycles run since power on; the RIOT timer counts against this
+#define prosystem_clock (prosystem_current->clock)
+#define prosystem_events (prosystem_current->events)
+#define prosystem_next_event (prosystem_current->nextEvent)
+// NMIs Maria has raised on this scanline and the CPU has yet to take
+#define prosystem_nmis (prosystem_current->nmis)
 
 // The scanline that the lightgun shot occurred at
-extern int lightgun_scanline;
+#define lightgun_scanline (prosystem_current->lightgunScanline)
 // The cycle that the lightgun shot occurred at
-extern float lightgun_cycle;
+#define lightgun_cycle (prosystem_current->lightgunCycle)
 // Whether the lightgun is enabled for the current cartridge
 //extern bool lightgun_enabled;
 
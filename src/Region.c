@@ -28,8 +28,6 @@
 
 #include "Region.h"
 
-uint8_t region_type = REGION_AUTO;
-
 static const rect REGION_DISPLAY_AREA_NTSC = {0, 16, 319, 258};
 static const rect REGION_VISIBLE_AREA_NTSC = {0, 26, 319, 250};
 static const uint8_t REGION_FREQUENCY_NTSC = 60;
@@ -37,6 +37,7 @@
 #include "Tia.h"
 
 extern void region_Reset(void);
-extern uint8_t region_type;
+
+#define region_type (prosystem_current->regionType)
 
 #endif
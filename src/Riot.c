@@ -28,16 +28,21 @@
 #include <stdbool.h>
 
 #include "Riot.h"
+#include "ProSystem.h"
 
-bool riot_timing = false;
-uint16_t riot_timer = TIM64T;
-uint8_t riot_intervals;
+#define riot_elapsed (prosystem_current->riot.elapsed)
+#define riot_hold (prosystem_current->riot.hold)
+#define riot_startTime (prosystem_current->riot.startTime)
+#define riot_start (prosystem_current->riot.start)
 
-uint8_t riot_dra = 0;
-uint8_t riot_drb = 0;
-static bool riot_elapsed;
-static int riot_currentTime;
-uint16_t riot_clocks;
+// The timer is kept as the cycle it was (re)started at plus the prescaler,
+// and INTIM is only derived when it is read. The frame loop calls
+// riot_UpdateTimer when prosystem_clock reaches riot_event, the point the
+// timer expires or stops. riot_hold marks that INTIM has not been refreshed
+// since the timer was set or expired and still reads from memory.
+static int riot_GetCurrentTime(void) {
+    return riot_startTime - (int)(prosystem_clock - riot_start);
+}
 
 void riot_Reset(void) {
     riot_SetDRA(0);
@@ -49,7 +54,10 @@ void riot_Reset(void) {
     riot_clocks = 0;
     
     riot_elapsed = false;
-    riot_currentTime = 0;
+    riot_hold = true;
+    riot_startTime = 0;
+    riot_start = prosystem_clock;
+    riot_event = prosystem_clock;
 }
 
 // ----------------------------------------------------------------------------
@@ -227,31 +235,94 @@ void riot_SetTimer(uint16_t timer, uint8_t intervals) {
     }
     
     if (riot_timing) {
-        riot_currentTime = riot_clocks * intervals;
+        riot_startTime = riot_clocks * intervals;
+        riot_start = prosystem_clock;
+        riot_event = riot_start + riot_startTime;
         riot_elapsed = false;
+        riot_hold = true;
+        prosystem_ScheduleClock(PROSYSTEM_EVENT_TIMER, riot_event);
     }
 }
 
-void riot_UpdateTimer(uint8_t cycles) {
-    riot_currentTime -= cycles;
-    if (!riot_elapsed && riot_currentTime > 0) {
-        memory_Write(INTIM, riot_currentTime / riot_clocks);
+void riot_UpdateTimer(void) {
+    if (!riot_timing) {
+        return;
     }
-    else {
-        if (riot_elapsed) {
-            if(riot_currentTime >= -255) {
-                memory_Write(INTIM, riot_currentTime);
-            }
-            else {
-                memory_Write(INTIM, 0);
-                riot_timing = false;
-            }
-        }
-        else {
-            riot_currentTime = riot_clocks;
-            memory_Write(INTIM, 0);
+    riot_hold = false;
+    
+    if ((int32_t)(prosystem_clock - riot_event) >= 0) {
+        if (!riot_elapsed) {
+            // Expired: restart one prescaler period and count through zero
+            riot_startTime = riot_clocks;
+            riot_start = prosystem_clock;
+            riot_event = prosystem_clock + riot_clocks + 256;
+            memory_ram[INTIM] = 0;
             memory_ram[INTFLG] |= 0x80;
             riot_elapsed = true;
+            riot_hold = true;
+        }
+        else {
+            // Past -255 the timer stops with INTIM at zero
+            memory_ram[INTIM] = 0;
+            riot_timing = false;
+            return;
         }
     }
+    
+    prosystem_ScheduleClock(PROSYSTEM_EVENT_TIMER, riot_event);
+}
+
+uint8_t riot_GetTimer(void) {
+    if (!riot_timing || (riot_hold && prosystem_clock == riot_start)) {
+        return memory_ram[INTIM];
+    }
+    
+    int currentTime = riot_GetCurrentTime();
+    if (!riot_elapsed) {
+        return currentTime / riot_clocks;
+    }
+    return currentTime;
+}
+
+// Returns for how many clocks after the given one riot_GetTimer keeps
+// returning the value it would return then, provided nothing is written
+// to the timer in between.
+uint32_t riot_GetTimerSteady(uint32_t clock) {
+    if (!riot_timing) {
+        return UINT32_MAX;
+    }
+    if (riot_elapsed || (riot_hold && clock == riot_start)) {
+        return 0;
+    }
+    
+    int currentTime = riot_startTime - (int)(clock - riot_start);
+    if (currentTime < 0) {
+        return 0;
+    }
+    return currentTime % riot_clocks;
+}
+
+// Brings the INTIM byte in memory up to date, for save states and anything
+// else that looks at memory_ram directly.
+void riot_StoreTimer(void) {
+    memory_ram[INTIM] = riot_GetTimer();
+}
+
+// Rebuilds the countdown after a state load. Save states only carry the
+// timer registers and the INTIM byte riot_StoreTimer left in memory, so the
+// timer restarts from INTIM at the current cycle. A pending INTFLG bit is
+// taken to mean the timer had already expired and is counting through zero.
+void riot_Restore(void) {
+    riot_start = prosystem_clock;
+    riot_hold = true;
+    riot_elapsed = riot_timing && (memory_ram[INTFLG] & 0x80);
+    
+    if (riot_elapsed) {
+        riot_startTime = memory_ram[INTIM]? memory_ram[INTIM] - 256: 0;
+        riot_event = riot_start + riot_startTime + 256;
+    }
+    else {
+        riot_startTime = riot_clocks * memory_ram[INTIM];
+        riot_event = riot_start + riot_startTime;
+    }
 }
@@ -29,17 +29,38 @@
 #include "Equates.h"
 #include "Memory.h"
 
+typedef struct RiotState {
+    bool timing;
+    uint16_t timer;
+    uint8_t intervals;
+    uint8_t dra;
+    uint8_t drb;
+    bool elapsed;
+    bool hold;
+    int startTime;
+    uint16_t clocks;
+    uint32_t start;
+    uint32_t event;
+} riot_state;
+
 extern void riot_Reset(void);
 extern void riot_SetInput(const uint8_t* input);
 extern void riot_SetDRA(uint8_t data);
 extern void riot_SetDRB(uint8_t data);
 extern void riot_SetTimer(uint16_t timer, uint8_t intervals);
-extern void riot_UpdateTimer(uint8_t cycles);
-extern bool riot_timing;
-extern uint16_t riot_timer;
-extern uint8_t riot_intervals;
-extern uint8_t riot_dra;
-extern uint8_t riot_drb;
-extern uint16_t riot_clocks;
+extern void riot_UpdateTimer(void);
+extern uint8_t riot_GetTimer(void);
+extern uint32_t riot_GetTimerSteady(uint32_t clock);
+extern void riot_StoreTimer(void);
+extern void riot_Restore(void);
+
+#define riot_timing (prosystem_current->riot.timing)
+#define riot_timer (prosystem_current->riot.timer)
+#define riot_intervals (prosystem_current->riot.intervals)
+#define riot_dra (prosystem_current->riot.dra)
+#define riot_drb (prosystem_current->riot.drb)
+#define riot_clocks (prosystem_current->riot.clocks)
+// The prosystem_clock cycle the timer next expires or stops at
+#define riot_event (prosystem_current->riot.event)
 
 #endif
@@ -25,25 +25,77 @@
 // ----------------------------------------------------------------------------
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "Sally.h"
+#include "ProSystem.h"
+
+// Instructions are dispatched through a table of label addresses where the
+// compiler supports it, otherwise through a plain switch. Each handler runs
+// its addressing mode and operation inline with the effective address kept
+// in a local. With the table, every handler retires its instruction and
+// jumps straight to the next one. Defining SALLY_THREADED as 0 forces the
+// switch, for comparing the two.
+#ifndef SALLY_THREADED
+#if defined(__GNUC__) || defined(__clang__)
+#define SALLY_THREADED 1
+#else
+#define SALLY_THREADED 0
+#endif
+#endif
+
+#if SALLY_THREADED
+#define SALLY_CASE(opcode) sally_op_##opcode
+#define SALLY_DEFAULT sally_op_default
+#define SALLY_NEXT                                                  \
+    SALLY_RETIRE();                                                 \
+    if (prosystem_cycles >= end || sally_stop) goto sally_done;     \
+    SALLY_FETCH();                                                  \
+    goto *SALLY_DISPATCH[opcode]
+#else
+#define SALLY_CASE(opcode) case opcode
+#define SALLY_DEFAULT default
+#define SALLY_NEXT break
+#endif
+
+// Instructions from cached ROM pages come straight from their decoded
+// entry; anything else goes through sally_Decode.
+#define SALLY_FETCH()                                               \
+    half_cycle = false;                                             \
+    code = pages[sally_pc.b.h];                                     \
+    if (code != NULL && code[sally_pc.b.l].size) {                  \
+        code += sally_pc.b.l;                                       \
+        opcode = code->opcode;                                      \
+        operand = code->operand;                                    \
+        sally_pc.w += code->size;                                   \
+    }                                                               \
+    else {                                                          \
+        opcode = sally_Decode(code, &operand);                      \
+    }                                                               \
+    cycles = SALLY_CYCLES[opcode]
+
+// A branch taken backwards over no more than itself and one read may be a
+// wait loop
+#define SALLY_IDLE()                                                \
+    if (cycles > 2 && operand.b.l >= 0xfb) {                        \
+        sally_Idle(pages, 0xfe - operand.b.l, cycles, end);         \
+    }
 
-uint8_t sally_a = 0;
-uint8_t sally_x = 0;
-uint8_t sally_y = 0;
-uint8_t sally_p = 0;
-uint8_t sally_s = 0;
-pair sally_pc = {0};
-
-static uint8_t sally_opcode;
-static pair sally_address;
-static uint32_t sally_cycles;
-
-// Whether the last operation resulted in a half cycle. (needs to be taken
-// into consideration by ProSystem when cycle counting). This can occur when
-// a TIA or RIOT are accessed (drops to 1.19Mhz when the TIA or RIOT chips
-// are accessed)
-bool half_cycle = false;
+#define SALLY_RETIRE()                                              \
+    prosystem_cycles += cycles << 2;                                \
+    if (half_cycle) prosystem_cycles += 2;                          \
+    prosystem_clock += cycles
+
+#define sally_stop (prosystem_current->sally.stop)
+#define sally_code (prosystem_current->sally.code)
+#define sally_codeTables (prosystem_current->sally.codeTables)
+#define sally_codeSources (prosystem_current->sally.codeSources)
+#define sally_codeTableCount (prosystem_current->sally.codeTableCount)
+#define sally_interpret (prosystem_current->sally.interpret)
+#define sally_busy (prosystem_current->sally.busy)
+#define sally_n (prosystem_current->sally.n)
+#define sally_z (prosystem_current->sally.z)
 
 typedef struct Flag {
     uint8_t C;
@@ -86,6 +138,29 @@ static const uint8_t SALLY_CYCLES[256] = {
     2,5,0,0,0,4,6,0,2,4,0,0,0,4,7,0,
 };
 
+// Operand bytes following each opcode
+static const uint8_t SALLY_LENGTH[256] = {
+    0,1,0,0,0,1,1,0,0,1,0,1,0,2,2,0,
+    1,1,0,0,0,1,1,0,0,2,0,0,0,2,2,0,
+    2,1,0,0,1,1,1,0,0,1,0,1,2,2,2,0,
+    1,1,0,0,0,1,1,0,0,2,0,0,0,2,2,0,
+    0,1,0,0,0,1,1,0,0,1,0,1,2,2,2,0,
+    1,1,0,0,0,1,1,0,0,2,0,0,0,2,2,0,
+    0,1,0,0,0,1,1,0,0,1,0,0,2,2,2,0,
+    1,1,0,0,0,1,1,0,0,2,0,0,0,2,2,0,
+    0,1,0,0,1,1,1,0,0,0,0,0,2,2,2,0,
+    1,1,0,0,1,1,1,0,0,2,0,0,0,2,0,0,
+    1,1,1,0,1,1,1,0,0,1,0,0,2,2,2,0,
+    1,1,0,0,1,1,1,0,0,2,0,0,2,2,2,0,
+    1,1,0,0,1,1,1,0,0,1,0,0,2,2,2,0,
+    1,1,0,0,0,1,1,0,0,2,0,0,0,2,2,0,
+    1,1,0,0,1,1,1,0,0,1,0,0,2,2,2,0,
+    1,1,0,0,0,1,1,0,0,2,0,0,0,2,2,0,
+};
+
+// Page table used in place of sally_code when running without the cache
+static sally_decoded* const SALLY_NO_CODE[MEMORY_PAGE_COUNT];
+
 static void sally_Push(uint8_t data) {
     memory_Write(sally_s + 256, data);
     sally_s--;
@@ -96,108 +171,231 @@ static uint8_t sally_Pop(void) {
     return memory_Read(sally_s + 256);
 }
 
-static void sally_Flags(uint8_t data) {
-    if (!data) {
-        sally_p |= SALLY_FLAG.Z;
-    }
-    else {
-        sally_p &= ~SALLY_FLAG.Z;
-    }
-    
-    if (data & 128) {
-        sally_p |= SALLY_FLAG.N;
-    }
-    else {
-        sally_p &= ~SALLY_FLAG.N;
-    }
+// N and Z are not kept in sally_p. Instead the values they were last taken
+// from are stored, and the flags are worked out only when something reads
+// them: N is bit 7 of sally_n and Z is set when sally_z is zero.
+static inline void sally_Flags(uint8_t data) {
+    sally_n = data;
+    sally_z = data;
 }
 
-static void sally_Branch(uint8_t branch) {
+static inline uint32_t sally_Branch(uint8_t branch, uint8_t offset) {
     if (branch) {
         pair temp = sally_pc;
-        sally_pc.w += (signed char)sally_address.b.l;
+        sally_pc.w += (signed char)offset;
         
         if (temp.b.h != sally_pc.b.h) {
-            sally_cycles += 2;
-        }
-        else {
-            sally_cycles++;
+            return 2;
         }
+        return 1;
     }
+    return 0;
 }
 
-static void sally_Delay(uint8_t delta) {
-    pair address1 = sally_address;
-    pair address2 = sally_address;
-    address1.w -= delta;
+static inline uint32_t sally_Delay(uint16_t address, uint8_t delta) {
+    pair address1;
+    pair address2;
+    address1.w = address - delta;
+    address2.w = address;
     
-    if (address1.b.h != address2.b.h) {
-        sally_cycles++;
-    }
+    return (address1.b.h != address2.b.h)? 1: 0;
 }
 
-static void sally_Absolute(void) {
-    sally_address.b.l = memory_Read(sally_pc.w++);
-    sally_address.b.h = memory_Read(sally_pc.w++);
+static inline uint16_t sally_Absolute(uint16_t operand) {
+    return operand;
 }
 
-static void sally_AbsoluteX(void) {
-    sally_address.b.l = memory_Read(sally_pc.w++);
-    sally_address.b.h = memory_Read(sally_pc.w++);
-    sally_address.w += sally_x;
+static inline uint16_t sally_AbsoluteX(uint16_t operand) {
+    return operand + sally_x;
 }
 
-static void sally_AbsoluteY(void) {
-    sally_address.b.l = memory_Read(sally_pc.w++);
-    sally_address.b.h = memory_Read(sally_pc.w++);
-    sally_address.w += sally_y;
+static inline uint16_t sally_AbsoluteY(uint16_t operand) {
+    return operand + sally_y;
 }
 
-static void sally_Immediate(void) {
-    sally_address.w = sally_pc.w++;
+// The operand byte itself, which pc has already moved past
+static inline uint16_t sally_Immediate(void) {
+    return sally_pc.w - 1;
 }
 
-static void sally_Indirect(void) {
-    pair base;
-    base.b.l = memory_Read(sally_pc.w++);
-    base.b.h = memory_Read(sally_pc.w++);
-    sally_address.b.l = memory_Read(base.w);
-    sally_address.b.h = memory_Read(base.w + 1);
+static inline uint16_t sally_Indirect(uint16_t operand) {
+    pair address;
+    address.b.l = memory_Read(operand);
+    address.b.h = memory_Read(operand + 1);
+    return address.w;
 }
 
-static void sally_IndirectX(void) {
-    sally_address.b.l = memory_Read(sally_pc.w++) + sally_x;
-    sally_address.b.h = memory_Read(sally_address.b.l + 1);
-    sally_address.b.l = memory_Read(sally_address.b.l);
+static inline uint16_t sally_IndirectX(uint16_t operand) {
+    pair address;
+    address.b.l = operand + sally_x;
+    address.b.h = memory_Read(address.b.l + 1);
+    address.b.l = memory_Read(address.b.l);
+    return address.w;
 }
 
-static void sally_IndirectY(void) {
-    sally_address.b.l = memory_Read(sally_pc.w++);
-    sally_address.b.h = memory_Read(sally_address.b.l + 1);
-    sally_address.b.l = memory_Read(sally_address.b.l);
-    sally_address.w += sally_y;
+static inline uint16_t sally_IndirectY(uint16_t operand) {
+    pair address;
+    address.b.l = operand;
+    address.b.h = memory_Read(address.b.l + 1);
+    address.b.l = memory_Read(address.b.l);
+    return address.w + sally_y;
 }
 
-static void sally_Relative(void) {
-    sally_address.w = memory_Read(sally_pc.w++);
+static inline uint16_t sally_Relative(uint16_t operand) {
+    return operand;
 }
 
-static void sally_ZeroPage(void) {
-    sally_address.w = memory_Read(sally_pc.w++);
+static inline uint16_t sally_ZeroPage(uint16_t operand) {
+    return operand;
 }
 
-static void sally_ZeroPageX(void) {
-    sally_address.w = memory_Read(sally_pc.w++);
-    sally_address.b.l += sally_x;
+static inline uint16_t sally_ZeroPageX(uint16_t operand) {
+    return (uint8_t)(operand + sally_x);
 }
 
-static void sally_ZeroPageY(void) {
-    sally_address.w = memory_Read(sally_pc.w++);
-    sally_address.b.l += sally_y;
+static inline uint16_t sally_ZeroPageY(uint16_t operand) {
+    return (uint8_t)(operand + sally_y);
 }
 
-static void sally_ADC(void) {
-    uint8_t data = memory_Read(sally_address.w);
+// Fetches the instruction at pc through the bus and moves pc past it. The
+// decoded form is kept in code, the entries for pc's page if it is cached,
+// when it lies wholly inside that page.
+static uint8_t sally_Decode(sally_decoded* code, pair* operand) {
+    uint8_t offset = sally_pc.b.l;
+    uint8_t opcode = memory_Read(sally_pc.w++);
+    uint8_t length = SALLY_LENGTH[opcode];
+    
+    operand->w = 0;
+    if (length > 0) {
+        operand->b.l = memory_Read(sally_pc.w++);
+    }
+    if (length > 1) {
+        operand->b.h = memory_Read(sally_pc.w++);
+    }
+    
+    if (code != NULL && offset + length < MEMORY_PAGE_SIZE) {
+        code[offset].opcode = opcode;
+        code[offset].size = length + 1;
+        code[offset].operand = *operand;
+    }
+    return opcode;
+}
+
+// Called with pc at the top of a possible wait loop: a branch or jump onto
+// itself, or a branch back onto a single read of MSTAT, INTIM or INTFLG,
+// whose length is given. cycles is what the branch or jump takes. The
+// flags the branch was taken on may not have come from that read, for
+// example when a run or an interrupt ends between the two, so the value
+// the read would give now is worked out without its side effects. Only if
+// a pass would then leave the registers and flags as they are, and clear
+// no INTFLG bit, is every pass the same as the last until the value read
+// changes. MSTAT and INTFLG can only change between runs, once the events
+// ending them are dispatched, and INTIM only when the timer ticks. The
+// passes that would be made before then are credited all at once,
+// stopping short of end so that the run still ends on the same
+// instruction. The read is only looked at once it has been decoded from a
+// cached ROM page.
+static void sally_Idle(sally_decoded* const* pages, uint8_t length, uint32_t cycles, uint32_t end) {
+    uint32_t period = cycles;
+    uint32_t steady = UINT32_MAX;
+    
+    if (sally_busy) {
+        return;
+    }
+    
+    if (length != 0) {
+        const sally_decoded* code = pages[sally_pc.b.h];
+        if (code == NULL) {
+            return;
+        }
+        
+        code += sally_pc.b.l;
+        if (code->size != length) {
+            return;
+        }
+        
+        uint8_t data;
+        switch (code->operand.w) {
+            case MSTAT:
+                data = memory_ram[MSTAT];
+                break;
+            
+            case INTFLG:
+            case INTFLG | 0x2:
+                data = memory_ram[INTFLG];
+                break;
+            
+            case INTIM:
+            case INTIM | 0x2:
+                // The next read happens once the branch retires
+                steady = riot_GetTimerSteady(prosystem_clock);
+                if (steady < cycles) {
+                    return;
+                }
+                steady -= cycles;
+                data = riot_GetTimer();
+                break;
+            
+            default:
+                return;
+        }
+        if (code->operand.w != MSTAT && (memory_ram[INTFLG] & 0x80)) {
+            return;
+        }
+        
+        switch (code->opcode) {
+            case 0x24: // BIT
+            case 0x2c:
+                if (!(sally_p & SALLY_FLAG.V) != !(data & 0x40) || !sally_z != !(data & sally_a)) {
+                    return;
+                }
+                break;
+            
+            case 0xa4: // LDY
+            case 0xac:
+                if (sally_y != data || !sally_z != !data) {
+                    return;
+                }
+                break;
+            
+            case 0xa5: // LDA
+            case 0xad:
+                if (sally_a != data || !sally_z != !data) {
+                    return;
+                }
+                break;
+            
+            case 0xa6: // LDX
+            case 0xae:
+                if (sally_x != data || !sally_z != !data) {
+                    return;
+                }
+                break;
+            
+            default:
+                return;
+        }
+        if ((sally_n ^ data) & 0x80) {
+            return;
+        }
+        period += SALLY_CYCLES[code->opcode];
+    }
+    
+    uint32_t retired = prosystem_cycles + (cycles << 2);
+    if (sally_stop || retired >= end) {
+        return;
+    }
+    
+    uint32_t passes = (end - 1 - retired) / (period << 2);
+    if (steady != UINT32_MAX && passes > steady / period + 1) {
+        passes = steady / period + 1;
+    }
+    prosystem_cycles += (passes * period) << 2;
+    prosystem_clock += passes * period;
+}
+
+static inline void sally_ADC(uint16_t address) {
+    uint8_t data = memory_Read(address);
     
     if (sally_p & SALLY_FLAG.D) {
         uint16_t al = (sally_a & 15) + (data & 15) + (sally_p & SALLY_FLAG.C);
@@ -208,19 +406,8 @@ static void sally_ADC(void) {
             ah++;
         }
         
-        if (!(sally_a + data + (sally_p & SALLY_FLAG.C))) {
-            sally_p |= SALLY_FLAG.Z;
-        }
-        else {
-            sally_p &= ~SALLY_FLAG.Z;
-        }
-        
-        if ((ah & 8) != 0) {
-            sally_p |= SALLY_FLAG.N;
-        }
-        else {
-            sally_p &= ~SALLY_FLAG.N;
-        }
+        sally_z = sally_a | data | (sally_p & SALLY_FLAG.C);
+        sally_n = ah << 4;
         
         if (~(sally_a ^ data) & ((ah << 4) ^ sally_a) & 128) {
             sally_p |= SALLY_FLAG.V;
@@ -265,12 +452,12 @@ static void sally_ADC(void) {
     }
 }
 
-static void sally_AND(void) {
-    sally_a &= memory_Read(sally_address.w);
+static inline void sally_AND(uint16_t address) {
+    sally_a &= memory_Read(address);
     sally_Flags(sally_a);
 }
 
-static void sally_ASLA(void) {
+static inline void sally_ASLA(void) {
     if(sally_a & 128) {
         sally_p |= SALLY_FLAG.C;
     }
@@ -282,8 +469,8 @@ static void sally_ASLA(void) {
     sally_Flags(sally_a);
 }
 
-static void sally_ASL(void) {
-    uint8_t data = memory_Read(sally_address.w);
+static inline void sally_ASL(uint16_t address) {
+    uint8_t data = memory_Read(address);
     
     if (data & 128) {
         sally_p |= SALLY_FLAG.C;
@@ -293,89 +480,82 @@ static void sally_ASL(void) {
     }
     
     data <<= 1;
-    memory_Write(sally_address.w, data);
+    memory_Write(address, data);
     sally_Flags(data);
 }
 
-static void sally_BCC(void) {
-    sally_Branch(!(sally_p & SALLY_FLAG.C));
+static inline uint32_t sally_BCC(uint8_t offset) {
+    return sally_Branch(!(sally_p & SALLY_FLAG.C), offset);
 }
 
-static void sally_BCS(void) {
-    sally_Branch(sally_p & SALLY_FLAG.C);
+static inline uint32_t sally_BCS(uint8_t offset) {
+    return sally_Branch(sally_p & SALLY_FLAG.C, offset);
 }
 
-static void sally_BEQ(void) {
-    sally_Branch(sally_p & SALLY_FLAG.Z);
+static inline uint32_t sally_BEQ(uint8_t offset) {
+    return sally_Branch(!sally_z, offset);
 }
 
-static void sally_BIT(void) {
-    uint8_t data = memory_Read(sally_address.w);
-    
-    if (!(data & sally_a)) {
-        sally_p |= SALLY_FLAG.Z;
-    }
-    else {
-        sally_p &= ~SALLY_FLAG.Z;
-    }
+static inline void sally_BIT(uint16_t address) {
+    uint8_t data = memory_Read(address);
     
+    sally_z = data & sally_a;
+    sally_n = data;
     sally_p &= ~SALLY_FLAG.V;
-    sally_p &= ~SALLY_FLAG.N;
     sally_p |= data & 64;
-    sally_p |= data & 128;
 }
 
-static void sally_BMI(void) {
-    sally_Branch(sally_p & SALLY_FLAG.N);
+static inline uint32_t sally_BMI(uint8_t offset) {
+    return sally_Branch(sally_n & 128, offset);
 }
 
-static void sally_BNE(void) {
-    sally_Branch(!(sally_p & SALLY_FLAG.Z));
+static inline uint32_t sally_BNE(uint8_t offset) {
+    return sally_Branch(sally_z != 0, offset);
 }
 
-static void sally_BPL(void) {
-    sally_Branch(!(sally_p & SALLY_FLAG.N));
+static inline uint32_t sally_BPL(uint8_t offset) {
+    return sally_Branch(!(sally_n & 128), offset);
 }
 
-static void sally_BRK(void) {
+static inline void sally_BRK(void) {
     sally_pc.w++;
     sally_p |= SALLY_FLAG.B;
     
     sally_Push(sally_pc.b.h);
     sally_Push(sally_pc.b.l);
-    sally_Push(sally_p);
+    sally_Push(sally_GetStatus());
     
     sally_p |= SALLY_FLAG.I;
-    sally_pc.b.l = memory_ram[SALLY_IRQ.L];
-    sally_pc.b.h = memory_ram[SALLY_IRQ.H];
+    sally_pc.b.l = memory_Peek(SALLY_IRQ.L);
+    sally_pc.b.h = memory_Peek(SALLY_IRQ.H);
 }
 
-static void sally_BVC(void) {
-    sally_Branch(!(sally_p & SALLY_FLAG.V));
+static inline uint32_t sally_BVC(uint8_t offset) {
+    return sally_Branch(!(sally_p & SALLY_FLAG.V), offset);
 }
 
-static void sally_BVS(void) {
-    sally_Branch(sally_p & SALLY_FLAG.V);
+static inline uint32_t sally_BVS(uint8_t offset) {
+    return sally_Branch(sally_p & SALLY_FLAG.V, offset);
 }
 
-static void sally_CLC(void) {
+static inline void sally_CLC(void) {
     sally_p &= ~SALLY_FLAG.C;
 }
 
-static void sally_CLD(void) {
+static inline void sally_CLD(void) {
     sally_p &= ~SALLY_FLAG.D;
 }
 
-static void sally_CLI(void) {
+static inline void sally_CLI(void) {
     sally_p &= ~SALLY_FLAG.I;
 }
 
-static void sally_CLV(void) {
+static inline void sally_CLV(void) {
     sally_p &= ~SALLY_FLAG.V;
 }
 
-static void sally_CMP(void) {
-    uint8_t data = memory_Read(sally_address.w);
+static inline void sally_CMP(uint16_t address) {
+    uint8_t data = memory_Read(address);
     
     if (sally_a >= data) {
         sally_p |= SALLY_FLAG.C;
@@ -387,8 +567,8 @@ static void sally_CMP(void) {
     sally_Flags(sally_a - data);
 }
 
-static void sally_CPX(void) {
-    uint8_t data = memory_Read(sally_address.w);
+static inline void sally_CPX(uint16_t address) {
+    uint8_t data = memory_Read(address);
     
     if (sally_x >= data) {
         sally_p |= SALLY_FLAG.C;
@@ -400,8 +580,8 @@ static void sally_CPX(void) {
     sally_Flags(sally_x - data);
 }
 
-static void sally_CPY(void) {
-    uint8_t data = memory_Read(sally_address.w);
+static inline void sally_CPY(uint16_t address) {
+    uint8_t data = memory_Read(address);
     
     if (sally_y >= data) {
         sally_p |= SALLY_FLAG.C;
@@ -413,67 +593,67 @@ static void sally_CPY(void) {
     sally_Flags(sally_y - data);
 }
 
-static void sally_DEC(void) {
-    uint8_t data = memory_Read(sally_address.w);
-    memory_Write(sally_address.w, --data);
+static inline void sally_DEC(uint16_t address) {
+    uint8_t data = memory_Read(address);
+    memory_Write(address, --data);
     sally_Flags(data);
 }
 
-static void sally_DEX(void) {
+static inline void sally_DEX(void) {
     sally_Flags(--sally_x);
 }
 
-static void sally_DEY(void) {
+static inline void sally_DEY(void) {
     sally_Flags(--sally_y);
 }
 
-static void sally_EOR(void) {
-    sally_a ^= memory_Read(sally_address.w);
+static inline void sally_EOR(uint16_t address) {
+    sally_a ^= memory_Read(address);
     sally_Flags(sally_a);
 }
 
-static void sally_INC(void) {
-    uint8_t data = memory_Read(sally_address.w);
-    memory_Write(sally_address.w, ++data);
+static inline void sally_INC(uint16_t address) {
+    uint8_t data = memory_Read(address);
+    memory_Write(address, ++data);
     sally_Flags(data);
 }
 
-static void sally_INX(void) {
+static inline void sally_INX(void) {
     sally_Flags(++sally_x);
 }
 
-static void sally_INY(void) {
+static inline void sally_INY(void) {
     sally_Flags(++sally_y);
 }
 
-static void sally_JMP(void) {
-    sally_pc = sally_address;
+static inline void sally_JMP(uint16_t address) {
+    sally_pc.w = address;
 }
 
-static void sally_JSR(void) {
+static inline void sally_JSR(uint16_t address) {
     sally_pc.w--;
     sally_Push(sally_pc.b.h);
     sally_Push(sally_pc.b.l);
     
-    sally_pc = sally_address;
+    sally_pc.w = address;
 }
 
-static void sally_LDA(void) {
-    sally_a = memory_Read(sally_address.w);
+static inline void sally_LDA(uint16_t address) {
+    sally_a = memory_Read(address);
     sally_Flags(sally_a);
 }
 
-static void sally_LDX(void) {
-    sally_x = memory_Read(sally_address.w);
+static inline void sally_LDX(uint16_t address) {
+    sally_x = memory_Read(address);
     sally_Flags(sally_x);
 }
 
-static void sally_LDY(void) {
-    sally_y = memory_Read(sally_address.w);
+static inline void sally_LDY(uint16_t address) {
+    sally_y = memory_Read(address);
     sally_Flags(sally_y);
 }
 
-static void sally_LSRA(void) {
+static inline void sally_LSRA(void) {
     sally_p &= ~SALLY_FLAG.C;
     sally_p |= sally_a & 1;
     
@@ -481,43 +661,43 @@ static void sally_LSRA(void) {
     sally_Flags(sally_a);
 }
 
-static void sally_LSR(void) {
-    uint8_t data = memory_Read(sally_address.w);
+static inline void sally_LSR(uint16_t address) {
+    uint8_t data = memory_Read(address);
     
     sally_p &= ~SALLY_FLAG.C;
     sally_p |= data & 1;
     
     data >>= 1;
-    memory_Write(sally_address.w, data);
+    memory_Write(address, data);
     sally_Flags(data);
 }
 
-static void sally_NOP(void) {
+static inline void sally_NOP(void) {
 }
 
-static void sally_ORA(void) {
-    sally_a |= memory_Read(sally_address.w);
+static inline void sally_ORA(uint16_t address) {
+    sally_a |= memory_Read(address);
     sally_Flags(sally_a);
 }
 
-static void sally_PHA(void) {
+static inline void sally_PHA(void) {
     sally_Push(sally_a);
 }
 
-static void sally_PHP(void) {
-    sally_Push(sally_p);
+static inline void sally_PHP(void) {
+    sally_Push(sally_GetStatus());
 }
 
-static void sally_PLA(void) {
+static inline void sally_PLA(void) {
     sally_a = sally_Pop();
     sally_Flags(sally_a);
 }
 
-static void sally_PLP(void) {
-    sally_p = sally_Pop();
+static inline void sally_PLP(void) {
+    sally_SetStatus(sally_Pop());
 }
 
-static void sally_ROLA(void) {
+static inline void sally_ROLA(void) {
     uint8_t temp = sally_p;
     
     if (sally_a & 128) {
@@ -532,8 +712,8 @@ static void sally_ROLA(void) {
     sally_Flags(sally_a);
 }
 
-static void sally_ROL(void) {
-    uint8_t data = memory_Read(sally_address.w);
+static inline void sally_ROL(uint16_t address) {
+    uint8_t data = memory_Read(address);
     uint8_t temp = sally_p;
     
     if (data & 128) {
@@ -545,11 +725,11 @@ static void sally_ROL(void) {
     
     data <<= 1;
     data |= temp & 1;
-    memory_Write(sally_address.w, data);
+    memory_Write(address, data);
     sally_Flags(data);
 }
 
-static void sally_RORA(void) {
+static inline void sally_RORA(void) {
     uint8_t temp = sally_p;
     
     sally_p &= ~SALLY_FLAG.C;
@@ -563,8 +743,8 @@ static void sally_RORA(void) {
     sally_Flags(sally_a);
 }
 
-static void sally_ROR(void) {
-    uint8_t data = memory_Read(sally_address.w);
+static inline void sally_ROR(uint16_t address) {
+    uint8_t data = memory_Read(address);
     uint8_t temp = sally_p;
     
     sally_p &= ~SALLY_FLAG.C;
@@ -575,24 +755,24 @@ static void sally_ROR(void) {
         data |= 128;
     }
     
-    memory_Write(sally_address.w, data);
+    memory_Write(address, data);
     sally_Flags(data);
 }
 
-static void sally_RTI(void) {
-    sally_p = sally_Pop();
+static inline void sally_RTI(void) {
+    sally_SetStatus(sally_Pop());
     sally_pc.b.l = sally_Pop();
     sally_pc.b.h = sally_Pop();
 }
 
-static void sally_RTS(void) {
+static inline void sally_RTS(void) {
     sally_pc.b.l = sally_Pop();
     sally_pc.b.h = sally_Pop();
     sally_pc.w++;
 }
 
-static void sally_SBC(void) {
-    uint8_t data = memory_Read(sally_address.w);
+static inline void sally_SBC(uint16_t address) {
+    uint8_t data = memory_Read(address);
     
     if (sally_p & SALLY_FLAG.D) {
         uint16_t al = (sally_a & 15) - (data & 15) - !(sally_p & SALLY_FLAG.C);
@@ -650,55 +830,55 @@ static void sally_SBC(void) {
     }
 }
 
-static void sally_SEC(void) {
+static inline void sally_SEC(void) {
     sally_p |= SALLY_FLAG.C;
 }
 
-static void sally_SED(void) {
+static inline void sally_SED(void) {
     sally_p |= SALLY_FLAG.D;
 }
 
-static void sally_SEI(void) {
+static inline void sally_SEI(void) {
     sally_p |= SALLY_FLAG.I;
 }
 
-static void sally_STA(void) {
-    memory_Write(sally_address.w, sally_a);
+static inline void sally_STA(uint16_t address) {
+    memory_Write(address, sally_a);
 }
 
-static void sally_stx(void) {
-    memory_Write(sally_address.w, sally_x);
+static inline void sally_stx(uint16_t address) {
+    memory_Write(address, sally_x);
 }
 
-static void sally_STY(void) {
-    memory_Write(sally_address.w, sally_y);
+static inline void sally_STY(uint16_t address) {
+    memory_Write(address, sally_y);
 }
 
-static void sally_TAX(void) {
+static inline void sally_TAX(void) {
     sally_x = sally_a;
     sally_Flags(sally_x);
 }
 
-static void sally_TAY(void) {
+static inline void sally_TAY(void) {
     sally_y = sally_a;
     sally_Flags(sally_y);
 }
 
-static void sally_TSX(void) {
+static inline void sally_TSX(void) {
     sally_x = sally_s;
     sally_Flags(sally_x);
 }
 
-static void sally_TXA(void) {
+static inline void sally_TXA(void) {
     sally_a = sally_x;
     sally_Flags(sally_a);
 }
 
-static void sally_TXS(void) {
+static inline void sally_TXS(void) {
     sally_s = sally_x;
 }
 
-static void sally_TYA(void) {
+static inline void sally_TYA(void) {
     sally_a = sally_y;
     sally_Flags(sally_a);
 }
@@ -707,55 +887,109 @@ void sally_Reset(void) {
     sally_a = 0;
     sally_x = 0;
     sally_y = 0;
-    sally_p = SALLY_FLAG.R;
+    sally_SetStatus(SALLY_FLAG.R);
     sally_s = 0;
     sally_pc.w = 0;
 }
 
-uint32_t sally_ExecuteInstruction(void) {
-    // Reset half cycle flag
-    half_cycle = false;
-
-    sally_opcode = memory_Read(sally_pc.w++);
-    sally_cycles = SALLY_CYCLES[sally_opcode];
-
-    switch (sally_opcode) {
-        case 0x00:
+// Runs instructions until at least budget cycles (in the same units as
+// prosystem_cycles) have passed or something on the bus calls sally_Stop,
+// and returns the cycles used. At least one instruction is always run.
+// prosystem_cycles and prosystem_clock are advanced after every instruction
+// so that devices see the current time.
+uint32_t sally_Run(uint32_t budget) {
+#if SALLY_THREADED
+    static const void* const SALLY_DISPATCH[256] = {
+        &&sally_op_0x00, &&sally_op_0x01, &&sally_op_default, &&sally_op_default, &&sally_op_default, &&sally_op_0x05, &&sally_op_0x06, &&sally_op_default,
+        &&sally_op_0x08, &&sally_op_0x09, &&sally_op_0x0a, &&sally_op_0x0b, &&sally_op_default, &&sally_op_0x0d, &&sally_op_0x0e, &&sally_op_default,
+        &&sally_op_0x10, &&sally_op_0x11, &&sally_op_default, &&sally_op_default, &&sally_op_default, &&sally_op_0x15, &&sally_op_0x16, &&sally_op_default,
+        &&sally_op_0x18, &&sally_op_0x19, &&sally_op_default, &&sally_op_default, &&sally_op_default, &&sally_op_0x1d, &&sally_op_0x1e, &&sally_op_default,
+        &&sally_op_0x20, &&sally_op_0x21, &&sally_op_default, &&sally_op_default, &&sally_op_0x24, &&sally_op_0x25, &&sally_op_0x26, &&sally_op_default,
+        &&sally_op_0x28, &&sally_op_0x29, &&sally_op_0x2a, &&sally_op_0x2b, &&sally_op_0x2c, &&sally_op_0x2d, &&sally_op_0x2e, &&sally_op_default,
+        &&sally_op_0x30, &&sally_op_0x31, &&sally_op_default, &&sally_op_default, &&sally_op_default, &&sally_op_0x35, &&sally_op_0x36, &&sally_op_default,
+        &&sally_op_0x38, &&sally_op_0x39, &&sally_op_default, &&sally_op_default, &&sally_op_default, &&sally_op_0x3d, &&sally_op_0x3e, &&sally_op_default,
+        &&sally_op_0x40, &&sally_op_0x41, &&sally_op_default, &&sally_op_default, &&sally_op_default, &&sally_op_0x45, &&sally_op_0x46, &&sally_op_default,
+        &&sally_op_0x48, &&sally_op_0x49, &&sally_op_0x4a, &&sally_op_0x4b, &&sally_op_0x4c, &&sally_op_0x4d, &&sally_op_0x4e, &&sally_op_default,
+        &&sally_op_0x50, &&sally_op_0x51, &&sally_op_default, &&sally_op_default, &&sally_op_default, &&sally_op_0x55, &&sally_op_0x56, &&sally_op_default,
+        &&sally_op_0x58, &&sally_op_0x59, &&sally_op_default, &&sally_op_default, &&sally_op_default, &&sally_op_0x5d, &&sally_op_0x5e, &&sally_op_default,
+        &&sally_op_0x60, &&sally_op_0x61, &&sally_op_default, &&sally_op_default, &&sally_op_default, &&sally_op_0x65, &&sally_op_0x66, &&sally_op_default,
+        &&sally_op_0x68, &&sally_op_0x69, &&sally_op_0x6a, &&sally_op_default, &&sally_op_0x6c, &&sally_op_0x6d, &&sally_op_0x6e, &&sally_op_default,
+        &&sally_op_0x70, &&sally_op_0x71, &&sally_op_default, &&sally_op_default, &&sally_op_default, &&sally_op_0x75, &&sally_op_0x76, &&sally_op_default,
+        &&sally_op_0x78, &&sally_op_0x79, &&sally_op_default, &&sally_op_default, &&sally_op_default, &&sally_op_0x7d, &&sally_op_0x7e, &&sally_op_default,
+        &&sally_op_default, &&sally_op_0x81, &&sally_op_default, &&sally_op_default, &&sally_op_0x84, &&sally_op_0x85, &&sally_op_0x86, &&sally_op_default,
+        &&sally_op_0x88, &&sally_op_default, &&sally_op_0x8a, &&sally_op_default, &&sally_op_0x8c, &&sally_op_0x8d, &&sally_op_0x8e, &&sally_op_default,
+        &&sally_op_0x90, &&sally_op_0x91, &&sally_op_default, &&sally_op_default, &&sally_op_0x94, &&sally_op_0x95, &&sally_op_0x96, &&sally_op_default,
+        &&sally_op_0x98, &&sally_op_0x99, &&sally_op_0x9a, &&sally_op_default, &&sally_op_default, &&sally_op_0x9d, &&sally_op_default, &&sally_op_default,
+        &&sally_op_0xa0, &&sally_op_0xa1, &&sally_op_0xa2, &&sally_op_default, &&sally_op_0xa4, &&sally_op_0xa5, &&sally_op_0xa6, &&sally_op_default,
+        &&sally_op_0xa8, &&sally_op_0xa9, &&sally_op_0xaa, &&sally_op_default, &&sally_op_0xac, &&sally_op_0xad, &&sally_op_0xae, &&sally_op_default,
+        &&sally_op_0xb0, &&sally_op_0xb1, &&sally_op_default, &&sally_op_default, &&sally_op_0xb4, &&sally_op_0xb5, &&sally_op_0xb6, &&sally_op_default,
+        &&sally_op_0xb8, &&sally_op_0xb9, &&sally_op_0xba, &&sally_op_default, &&sally_op_0xbc, &&sally_op_0xbd, &&sally_op_0xbe, &&sally_op_default,
+        &&sally_op_0xc0, &&sally_op_0xc1, &&sally_op_default, &&sally_op_default, &&sally_op_0xc4, &&sally_op_0xc5, &&sally_op_0xc6, &&sally_op_default,
+        &&sally_op_0xc8, &&sally_op_0xc9, &&sally_op_0xca, &&sally_op_default, &&sally_op_0xcc, &&sally_op_0xcd, &&sally_op_0xce, &&sally_op_default,
+        &&sally_op_0xd0, &&sally_op_0xd1, &&sally_op_default, &&sally_op_default, &&sally_op_default, &&sally_op_0xd5, &&sally_op_0xd6, &&sally_op_default,
+        &&sally_op_0xd8, &&sally_op_0xd9, &&sally_op_default, &&sally_op_default, &&sally_op_default, &&sally_op_0xdd, &&sally_op_0xde, &&sally_op_default,
+        &&sally_op_0xe0, &&sally_op_0xe1, &&sally_op_default, &&sally_op_default, &&sally_op_0xe4, &&sally_op_0xe5, &&sally_op_0xe6, &&sally_op_default,
+        &&sally_op_0xe8, &&sally_op_0xe9, &&sally_op_0xea, &&sally_op_default, &&sally_op_0xec, &&sally_op_0xed, &&sally_op_0xee, &&sally_op_default,
+        &&sally_op_0xf0, &&sally_op_0xf1, &&sally_op_default, &&sally_op_default, &&sally_op_default, &&sally_op_0xf5, &&sally_op_0xf6, &&sally_op_default,
+        &&sally_op_0xf8, &&sally_op_0xf9, &&sally_op_default, &&sally_op_default, &&sally_op_default, &&sally_op_0xfd, &&sally_op_0xfe, &&sally_op_default,
+    };
+#endif
+    uint32_t start = prosystem_cycles;
+    uint32_t end = start + budget;
+    uint32_t cycles;
+    uint16_t address;
+    uint8_t opcode;
+    pair operand;
+    sally_decoded* code;
+    sally_decoded* const* pages = sally_interpret? SALLY_NO_CODE: sally_code;
+    
+    sally_stop = false;
+    
+#if SALLY_THREADED
+    SALLY_FETCH();
+    goto *SALLY_DISPATCH[opcode];
+    {
+#else
+    for (;;) {
+        SALLY_FETCH();
+        switch (opcode) {
+#endif
+        SALLY_CASE(0x00):
             sally_BRK();
-            break;
+            SALLY_NEXT;
         
-        case 0x01:
-            sally_IndirectX();
-            sally_ORA();
-            break;
+        SALLY_CASE(0x01):
+            address = sally_IndirectX(operand.w);
+            sally_ORA(address);
+            SALLY_NEXT;
         
-        case 0x05:
-            sally_ZeroPage();
-            sally_ORA();
-            break;
+        SALLY_CASE(0x05):
+            address = sally_ZeroPage(operand.w);
+            sally_ORA(address);
+            SALLY_NEXT;
         
-        case 0x06:
-            sally_ZeroPage();
-            sally_ASL();
-            break;
+        SALLY_CASE(0x06):
+            address = sally_ZeroPage(operand.w);
+            sally_ASL(address);
+            SALLY_NEXT;
         
-        case 0x08:
+        SALLY_CASE(0x08):
             sally_PHP();
-            break;
+            SALLY_NEXT;
         
-        case 0x09:
-            sally_Immediate();
-            sally_ORA();
-            break;
+        SALLY_CASE(0x09):
+            address = sally_Immediate();
+            sally_ORA(address);
+            SALLY_NEXT;
         
-        case 0x0a:
+        SALLY_CASE(0x0a):
             sally_ASLA();
-            break;
+            SALLY_NEXT;
         
-        case 0x0b: // ANC
-        case 0x2b: { // ANC
-            sally_Immediate();
-            sally_AND();
+        SALLY_CASE(0x0b): // ANC
+        SALLY_CASE(0x2b): { // ANC
+            address = sally_Immediate();
+            sally_AND(address);
             if (sally_a & 128) {
                 sally_p |= SALLY_FLAG.C;
             }
@@ -763,749 +997,905 @@ uint32_t sally_ExecuteInstruction(void) {
                 //sally_p &= ~SALLY_FLAG.C;
                 sally_p = (sally_p & ~SALLY_FLAG.C) & 0xFF;
             }
-            break;
+            SALLY_NEXT;
         }
-        case 0x0d:
-            sally_Absolute();
-            sally_ORA();
-            break;
-        
-        case 0x0e:
-            sally_Absolute();
-            sally_ASL();
-            break;
-        
-        case 0x10:
-            sally_Relative();
-            sally_BPL();
-            break;
-        
-        case 0x11:
-            sally_IndirectY();
-            sally_ORA();
-            sally_Delay(sally_y);
-            break;
-        
-        case 0x15:
-            sally_ZeroPageX();
-            sally_ORA();
-            break;
-        
-        case 0x16:
-            sally_ZeroPageX();
-            sally_ASL();
-            break;
-        
-        case 0x18:
+        SALLY_CASE(0x0d):
+            address = sally_Absolute(operand.w);
+            sally_ORA(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x0e):
+            address = sally_Absolute(operand.w);
+            sally_ASL(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x10):
+            address = sally_Relative(operand.w);
+            cycles += sally_BPL(address);
+            SALLY_IDLE();
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x11):
+            address = sally_IndirectY(operand.w);
+            sally_ORA(address);
+            cycles += sally_Delay(address, sally_y);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x15):
+            address = sally_ZeroPageX(operand.w);
+            sally_ORA(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x16):
+            address = sally_ZeroPageX(operand.w);
+            sally_ASL(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x18):
             sally_CLC();
-            break;
-        
-        case 0x19:
-            sally_AbsoluteY();
-            sally_ORA();
-            sally_Delay(sally_y);
-            break;
-        
-        case 0x1d:
-            sally_AbsoluteX();
-            sally_ORA();
-            sally_Delay(sally_x);
-            break;
-        
-        case 0x1e:
-            sally_AbsoluteX();
-            sally_ASL();
-            break;
-        
-        case 0x20:
-            sally_Absolute();
-            sally_JSR();
-            break;
-        
-        case 0x21:
-            sally_IndirectX();
-            sally_AND();
-            break;
-        
-        case 0x24:
-            sally_ZeroPage();
-            sally_BIT();
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x19):
+            address = sally_AbsoluteY(operand.w);
+            sally_ORA(address);
+            cycles += sally_Delay(address, sally_y);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x1d):
+            address = sally_AbsoluteX(operand.w);
+            sally_ORA(address);
+            cycles += sally_Delay(address, sally_x);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x1e):
+            address = sally_AbsoluteX(operand.w);
+            sally_ASL(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x20):
+            address = sally_Absolute(operand.w);
+            sally_JSR(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x21):
+            address = sally_IndirectX(operand.w);
+            sally_AND(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x24):
+            address = sally_ZeroPage(operand.w);
+            sally_BIT(address);
             // Add a half cycle if RIOT/TIA location is accessed. We only track
             // INPT4 since it is the only one that is accessed during the
             // lightgun hit detection loop. This should be extended to take into
             // consideration all RIOT and TIA accesses.
-            if (sally_address.w == INPT4) {
+            if (address == INPT4) {
                 half_cycle = true;
             }
-            break;
+            SALLY_NEXT;
         
-        case 0x25:
-            sally_ZeroPage();
-            sally_AND();
-            break;
+        SALLY_CASE(0x25):
+            address = sally_ZeroPage(operand.w);
+            sally_AND(address);
+            SALLY_NEXT;
         
-        case 0x26:
-            sally_ZeroPage();
-            sally_ROL();
-            break;
+        SALLY_CASE(0x26):
+            address = sally_ZeroPage(operand.w);
+            sally_ROL(address);
+            SALLY_NEXT;
         
-        case 0x28:
+        SALLY_CASE(0x28):
             sally_PLP();
-            break;
+            SALLY_NEXT;
         
-        case 0x29:
-            sally_Immediate();
-            sally_AND();
-            break;
+        SALLY_CASE(0x29):
+            address = sally_Immediate();
+            sally_AND(address);
+            SALLY_NEXT;
         
-        case 0x2a:
+        SALLY_CASE(0x2a):
             sally_ROLA();
-            break;
-        
-        case 0x2c:
-            sally_Absolute();
-            sally_BIT();
-            break;
-        
-        case 0x2d:
-            sally_Absolute();
-            sally_AND();
-            break;
-        
-        case 0x2e:
-            sally_Absolute();
-            sally_ROL();
-            break;
-        
-        case 0x30:
-            sally_Relative();
-            sally_BMI();
-            break;
-        
-        case 0x31:
-            sally_IndirectY();
-            sally_AND();
-            sally_Delay(sally_y);
-            break;
-        
-        case 0x35:
-            sally_ZeroPageX();
-            sally_AND();
-            break;
-        
-        case 0x36:
-            sally_ZeroPageX();
-            sally_ROL();
-            break;
-        
-        case 0x38:
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x2c):
+            address = sally_Absolute(operand.w);
+            sally_BIT(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x2d):
+            address = sally_Absolute(operand.w);
+            sally_AND(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x2e):
+            address = sally_Absolute(operand.w);
+            sally_ROL(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x30):
+            address = sally_Relative(operand.w);
+            cycles += sally_BMI(address);
+            SALLY_IDLE();
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x31):
+            address = sally_IndirectY(operand.w);
+            sally_AND(address);
+            cycles += sally_Delay(address, sally_y);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x35):
+            address = sally_ZeroPageX(operand.w);
+            sally_AND(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x36):
+            address = sally_ZeroPageX(operand.w);
+            sally_ROL(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x38):
             sally_SEC();
-            break;
-        
-        case 0x39:
-            sally_AbsoluteY();
-            sally_AND();
-            sally_Delay(sally_y);
-            break;
-        
-        case 0x3d:
-            sally_AbsoluteX();
-            sally_AND();
-            sally_Delay(sally_x);
-            break;
-        
-        case 0x3e:
-            sally_AbsoluteX();
-            sally_ROL();
-            break;
-        
-        case 0x40:
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x39):
+            address = sally_AbsoluteY(operand.w);
+            sally_AND(address);
+            cycles += sally_Delay(address, sally_y);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x3d):
+            address = sally_AbsoluteX(operand.w);
+            sally_AND(address);
+            cycles += sally_Delay(address, sally_x);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x3e):
+            address = sally_AbsoluteX(operand.w);
+            sally_ROL(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x40):
             sally_RTI();
-            break;
+            SALLY_NEXT;
         
-        case 0x41:
-            sally_IndirectX();
-            sally_EOR();
-            break;
+        SALLY_CASE(0x41):
+            address = sally_IndirectX(operand.w);
+            sally_EOR(address);
+            SALLY_NEXT;
         
-        case 0x45:
-            sally_ZeroPage();
-            sally_EOR();
-            break;
+        SALLY_CASE(0x45):
+            address = sally_ZeroPage(operand.w);
+            sally_EOR(address);
+            SALLY_NEXT;
         
-        case 0x46:
-            sally_ZeroPage();
-            sally_LSR();
-            break;
+        SALLY_CASE(0x46):
+            address = sally_ZeroPage(operand.w);
+            sally_LSR(address);
+            SALLY_NEXT;
         
-        case 0x48:
+        SALLY_CASE(0x48):
             sally_PHA();
-            break;
+            SALLY_NEXT;
         
-        case 0x49:
-            sally_Immediate();
-            sally_EOR();
-            break;
+        SALLY_CASE(0x49):
+            address = sally_Immediate();
+            sally_EOR(address);
+            SALLY_NEXT;
         
-        case 0x4a:
+        SALLY_CASE(0x4a):
             sally_LSRA();
-            break;
+            SALLY_NEXT;
         
-        case 0x4b: // ALR (ASR)
-            sally_Immediate();
-            sally_AND();
+        SALLY_CASE(0x4b): // ALR (ASR)
+            address = sally_Immediate();
+            sally_AND(address);
             sally_LSRA();
-            break;
-        
-        case 0x4c:
-            sally_Absolute();
-            sally_JMP();
-            break;
-        
-        case 0x4d:
-            sally_Absolute();
-            sally_EOR();
-            break;
-        
-        case 0x4e:
-            sally_Absolute();
-            sally_LSR();
-            break;
-        
-        case 0x50:
-            sally_Relative();
-            sally_BVC();
-            break;
-        
-        case 0x51:
-            sally_IndirectY();
-            sally_EOR();
-            sally_Delay(sally_y);
-            break;
-        
-        case 0x55:
-            sally_ZeroPageX();
-            sally_EOR();
-            break;
-        
-        case 0x56:
-            sally_ZeroPageX();
-            sally_LSR();
-            break;
+            SALLY_NEXT;
         
-        case 0x58:
+        SALLY_CASE(0x4c):
+            address = sally_Absolute(operand.w);
+            if (address == (uint16_t)(sally_pc.w - 3)) {
+                sally_Idle(pages, 0, cycles, end);
+            }
+            sally_JMP(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x4d):
+            address = sally_Absolute(operand.w);
+            sally_EOR(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x4e):
+            address = sally_Absolute(operand.w);
+            sally_LSR(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x50):
+            address = sally_Relative(operand.w);
+            cycles += sally_BVC(address);
+            SALLY_IDLE();
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x51):
+            address = sally_IndirectY(operand.w);
+            sally_EOR(address);
+            cycles += sally_Delay(address, sally_y);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x55):
+            address = sally_ZeroPageX(operand.w);
+            sally_EOR(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x56):
+            address = sally_ZeroPageX(operand.w);
+            sally_LSR(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x58):
             sally_CLI();
-            break;
-        
-        case 0x59:
-            sally_AbsoluteY();
-            sally_EOR();
-            sally_Delay(sally_y);
-            break;
-        
-        case 0x5d:
-            sally_AbsoluteX();
-            sally_EOR();
-            sally_Delay(sally_x);
-            break;
-        
-        case 0x5e:
-            sally_AbsoluteX();
-            sally_LSR();
-            break;
-        
-        case 0x60:
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x59):
+            address = sally_AbsoluteY(operand.w);
+            sally_EOR(address);
+            cycles += sally_Delay(address, sally_y);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x5d):
+            address = sally_AbsoluteX(operand.w);
+            sally_EOR(address);
+            cycles += sally_Delay(address, sally_x);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x5e):
+            address = sally_AbsoluteX(operand.w);
+            sally_LSR(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x60):
             sally_RTS();
-            break;
+            SALLY_NEXT;
         
-        case 0x61:
-            sally_IndirectX();
-            sally_ADC();
-            break;
+        SALLY_CASE(0x61):
+            address = sally_IndirectX(operand.w);
+            sally_ADC(address);
+            SALLY_NEXT;
         
-        case 0x65:
-            sally_ZeroPage();
-            sally_ADC();
-            break;
+        SALLY_CASE(0x65):
+            address = sally_ZeroPage(operand.w);
+            sally_ADC(address);
+            SALLY_NEXT;
         
-        case 0x66:
-            sally_ZeroPage();
-            sally_ROR();
-            break;
+        SALLY_CASE(0x66):
+            address = sally_ZeroPage(operand.w);
+            sally_ROR(address);
+            SALLY_NEXT;
         
-        case 0x68:
+        SALLY_CASE(0x68):
             sally_PLA();
-            break;
+            SALLY_NEXT;
         
-        case 0x69:
-            sally_Immediate();
-            sally_ADC();
-            break;
+        SALLY_CASE(0x69):
+            address = sally_Immediate();
+            sally_ADC(address);
+            SALLY_NEXT;
         
-        case 0x6a:
+        SALLY_CASE(0x6a):
             sally_RORA();
-            break;
-        
-        case 0x6c:
-            sally_Indirect();
-            sally_JMP();
-            break;
-        
-        case 0x6d:
-            sally_Absolute();
-            sally_ADC();
-            break;
-        
-        case 0x6e:
-            sally_Absolute();
-            sally_ROR();
-            break;
-        
-        case 0x70:
-            sally_Relative();
-            sally_BVS();
-            break;
-        
-        case 0x71:
-            sally_IndirectY();
-            sally_ADC();
-            sally_Delay(sally_y);
-            break;
-        
-        case 0x75:
-            sally_ZeroPageX();
-            sally_ADC();
-            break;
-        
-        case 0x76:
-            sally_ZeroPageX();
-            sally_ROR();
-            break;
-        
-        case 0x78:
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x6c):
+            address = sally_Indirect(operand.w);
+            sally_JMP(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x6d):
+            address = sally_Absolute(operand.w);
+            sally_ADC(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x6e):
+            address = sally_Absolute(operand.w);
+            sally_ROR(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x70):
+            address = sally_Relative(operand.w);
+            cycles += sally_BVS(address);
+            SALLY_IDLE();
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x71):
+            address = sally_IndirectY(operand.w);
+            sally_ADC(address);
+            cycles += sally_Delay(address, sally_y);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x75):
+            address = sally_ZeroPageX(operand.w);
+            sally_ADC(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x76):
+            address = sally_ZeroPageX(operand.w);
+            sally_ROR(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x78):
             sally_SEI();
-            break;
-        
-        case 0x79:
-            sally_AbsoluteY();
-            sally_ADC();
-            sally_Delay(sally_y);
-            break;
-        
-        case 0x7d:
-            sally_AbsoluteX();
-            sally_ADC();
-            sally_Delay(sally_x);
-            break;
-        
-        case 0x7e:
-            sally_AbsoluteX();
-            sally_ROR();
-            break;
-        
-        case 0x81:
-            sally_IndirectX();
-            sally_STA();
-            break;
-        
-        case 0x84:
-            sally_ZeroPage();
-            sally_STY();
-            break;
-        
-        case 0x85:
-            sally_ZeroPage();
-            sally_STA();
-            break;
-        
-        case 0x86:
-            sally_ZeroPage();
-            sally_stx();
-            break;
-        
-        case 0x88:
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x79):
+            address = sally_AbsoluteY(operand.w);
+            sally_ADC(address);
+            cycles += sally_Delay(address, sally_y);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x7d):
+            address = sally_AbsoluteX(operand.w);
+            sally_ADC(address);
+            cycles += sally_Delay(address, sally_x);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x7e):
+            address = sally_AbsoluteX(operand.w);
+            sally_ROR(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x81):
+            address = sally_IndirectX(operand.w);
+            sally_STA(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x84):
+            address = sally_ZeroPage(operand.w);
+            sally_STY(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x85):
+            address = sally_ZeroPage(operand.w);
+            sally_STA(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x86):
+            address = sally_ZeroPage(operand.w);
+            sally_stx(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x88):
             sally_DEY();
-            break;
+            SALLY_NEXT;
         
-        case 0x8a:
+        SALLY_CASE(0x8a):
             sally_TXA();
-            break;
-        
-        case 0x8c:
-            sally_Absolute();
-            sally_STY();
-            break;
-        
-        case 0x8d:
-            sally_Absolute();
-            sally_STA();
-            break;
-        
-        case 0x8e:
-            sally_Absolute();
-            sally_stx();
-            break;
-        
-        case 0x90:
-            sally_Relative();
-            sally_BCC();
-            break;
-        
-        case 0x91:
-            sally_IndirectY();
-            sally_STA();
-            break;
-        
-        case 0x94:
-            sally_ZeroPageX();
-            sally_STY();
-            break;
-        
-        case 0x95:
-            sally_ZeroPageX();
-            sally_STA();
-            break;
-        
-        case 0x96:
-            sally_ZeroPageY();
-            sally_stx();
-            break;
-        
-        case 0x98:
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x8c):
+            address = sally_Absolute(operand.w);
+            sally_STY(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x8d):
+            address = sally_Absolute(operand.w);
+            sally_STA(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x8e):
+            address = sally_Absolute(operand.w);
+            sally_stx(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x90):
+            address = sally_Relative(operand.w);
+            cycles += sally_BCC(address);
+            SALLY_IDLE();
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x91):
+            address = sally_IndirectY(operand.w);
+            sally_STA(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x94):
+            address = sally_ZeroPageX(operand.w);
+            sally_STY(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x95):
+            address = sally_ZeroPageX(operand.w);
+            sally_STA(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x96):
+            address = sally_ZeroPageY(operand.w);
+            sally_stx(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x98):
             sally_TYA();
-            break;
+            SALLY_NEXT;
         
-        case 0x99:
-            sally_AbsoluteY();
-            sally_STA();
-            break;
+        SALLY_CASE(0x99):
+            address = sally_AbsoluteY(operand.w);
+            sally_STA(address);
+            SALLY_NEXT;
         
-        case 0x9a:
+        SALLY_CASE(0x9a):
             sally_TXS();
-            break;
-        
-        case 0x9d:
-            sally_AbsoluteX();
-            sally_STA();
-            break;
-        
-        case 0xa0:
-            sally_Immediate();
-            sally_LDY();
-            break;
-        
-        case 0xa1:
-            sally_IndirectX();
-            sally_LDA();
-            break;
-        
-        case 0xa2:
-            sally_Immediate();
-            sally_LDX();
-            break;
-        
-        case 0xa4:
-            sally_ZeroPage();
-            sally_LDY();
-            break;
-        
-        case 0xa5:
-            sally_ZeroPage();
-            sally_LDA();
-            break;
-        
-        case 0xa6:
-            sally_ZeroPage();
-            sally_LDX();
-            break;
-        
-        case 0xa8:
+            SALLY_NEXT;
+        
+        SALLY_CASE(0x9d):
+            address = sally_AbsoluteX(operand.w);
+            sally_STA(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xa0):
+            address = sally_Immediate();
+            sally_LDY(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xa1):
+            address = sally_IndirectX(operand.w);
+            sally_LDA(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xa2):
+            address = sally_Immediate();
+            sally_LDX(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xa4):
+            address = sally_ZeroPage(operand.w);
+            sally_LDY(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xa5):
+            address = sally_ZeroPage(operand.w);
+            sally_LDA(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xa6):
+            address = sally_ZeroPage(operand.w);
+            sally_LDX(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xa8):
             sally_TAY();
-            break;
+            SALLY_NEXT;
         
-        case 0xa9:
-            sally_Immediate();
-            sally_LDA();
-            break;
+        SALLY_CASE(0xa9):
+            address = sally_Immediate();
+            sally_LDA(address);
+            SALLY_NEXT;
         
-        case 0xaa:
+        SALLY_CASE(0xaa):
             sally_TAX();
-            break;
-        
-        case 0xac:
-            sally_Absolute();
-            sally_LDY();
-            break;
-        
-        case 0xad:
-            sally_Absolute();
-            sally_LDA();
-            break;
-        
-        case 0xae:
-            sally_Absolute();
-            sally_LDX();
-            break;
-        
-        case 0xb0:
-            sally_Relative();
-            sally_BCS();
-            break;
-        
-        case 0xb1:
-            sally_IndirectY();
-            sally_LDA();
-            sally_Delay(sally_y);
-            break;
-        
-        case 0xb4:
-            sally_ZeroPageX();
-            sally_LDY();
-            break;
-        
-        case 0xb5:
-            sally_ZeroPageX();
-            sally_LDA();
-            break;
-        
-        case 0xb6:
-            sally_ZeroPageY();
-            sally_LDX();
-            break;
-        
-        case 0xb8:
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xac):
+            address = sally_Absolute(operand.w);
+            sally_LDY(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xad):
+            address = sally_Absolute(operand.w);
+            sally_LDA(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xae):
+            address = sally_Absolute(operand.w);
+            sally_LDX(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xb0):
+            address = sally_Relative(operand.w);
+            cycles += sally_BCS(address);
+            SALLY_IDLE();
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xb1):
+            address = sally_IndirectY(operand.w);
+            sally_LDA(address);
+            cycles += sally_Delay(address, sally_y);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xb4):
+            address = sally_ZeroPageX(operand.w);
+            sally_LDY(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xb5):
+            address = sally_ZeroPageX(operand.w);
+            sally_LDA(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xb6):
+            address = sally_ZeroPageY(operand.w);
+            sally_LDX(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xb8):
             sally_CLV();
-            break;
+            SALLY_NEXT;
         
-        case 0xb9:
-            sally_AbsoluteY();
-            sally_LDA();
-            sally_Delay(sally_y);
-            break;
+        SALLY_CASE(0xb9):
+            address = sally_AbsoluteY(operand.w);
+            sally_LDA(address);
+            cycles += sally_Delay(address, sally_y);
+            SALLY_NEXT;
         
-        case 0xba:
+        SALLY_CASE(0xba):
             sally_TSX();
-            break;
-        
-        case 0xbc:
-            sally_AbsoluteX();
-            sally_LDY();
-            sally_Delay(sally_x);
-            break;
-        
-        case 0xbd:
-            sally_AbsoluteX();
-            sally_LDA();
-            sally_Delay(sally_x);
-            break;
-        
-        case 0xbe:
-            sally_AbsoluteY();
-            sally_LDX();
-            sally_Delay(sally_y);
-            break;
-        
-        case 0xc0:
-            sally_Immediate();
-            sally_CPY();
-            break;
-        
-        case 0xc1:
-            sally_IndirectX();
-            sally_CMP();
-            break;
-        
-        case 0xc4:
-            sally_ZeroPage();
-            sally_CPY();
-            break;
-        
-        case 0xc5:
-            sally_ZeroPage();
-            sally_CMP();
-            break;
-        
-        case 0xc6:
-            sally_ZeroPage();
-            sally_DEC();
-            break;
-        
-        case 0xc8:
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xbc):
+            address = sally_AbsoluteX(operand.w);
+            sally_LDY(address);
+            cycles += sally_Delay(address, sally_x);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xbd):
+            address = sally_AbsoluteX(operand.w);
+            sally_LDA(address);
+            cycles += sally_Delay(address, sally_x);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xbe):
+            address = sally_AbsoluteY(operand.w);
+            sally_LDX(address);
+            cycles += sally_Delay(address, sally_y);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xc0):
+            address = sally_Immediate();
+            sally_CPY(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xc1):
+            address = sally_IndirectX(operand.w);
+            sally_CMP(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xc4):
+            address = sally_ZeroPage(operand.w);
+            sally_CPY(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xc5):
+            address = sally_ZeroPage(operand.w);
+            sally_CMP(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xc6):
+            address = sally_ZeroPage(operand.w);
+            sally_DEC(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xc8):
             sally_INY();
-            break;
+            SALLY_NEXT;
         
-        case 0xc9:
-            sally_Immediate();
-            sally_CMP();
-            break;
+        SALLY_CASE(0xc9):
+            address = sally_Immediate();
+            sally_CMP(address);
+            SALLY_NEXT;
         
-        case 0xca:
+        SALLY_CASE(0xca):
             sally_DEX();
-            break;
-        
-        case 0xcc:
-            sally_Absolute();
-            sally_CPY();
-            break;
-        
-        case 0xcd:
-            sally_Absolute();
-            sally_CMP();
-            break;
-        
-        case 0xce:
-            sally_Absolute();
-            sally_DEC();
-            break;
-        
-        case 0xd0:
-            sally_Relative();
-            sally_BNE();
-            break;
-        
-        case 0xd1:
-            sally_IndirectY();
-            sally_CMP();
-            sally_Delay(sally_y);
-            break;
-        
-        case 0xd5:
-            sally_ZeroPageX();
-            sally_CMP();
-            break;
-        
-        case 0xd6:
-            sally_ZeroPageX();
-            sally_DEC();
-            break;
-        
-        case 0xd8:
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xcc):
+            address = sally_Absolute(operand.w);
+            sally_CPY(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xcd):
+            address = sally_Absolute(operand.w);
+            sally_CMP(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xce):
+            address = sally_Absolute(operand.w);
+            sally_DEC(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xd0):
+            address = sally_Relative(operand.w);
+            cycles += sally_BNE(address);
+            SALLY_IDLE();
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xd1):
+            address = sally_IndirectY(operand.w);
+            sally_CMP(address);
+            cycles += sally_Delay(address, sally_y);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xd5):
+            address = sally_ZeroPageX(operand.w);
+            sally_CMP(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xd6):
+            address = sally_ZeroPageX(operand.w);
+            sally_DEC(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xd8):
             sally_CLD();
-            break;
-        
-        case 0xd9:
-            sally_AbsoluteY();
-            sally_CMP();
-            sally_Delay(sally_y);
-            break;
-        
-        case 0xdd:
-            sally_AbsoluteX();
-            sally_CMP();
-            sally_Delay(sally_x);
-            break;
-        
-        case 0xde:
-            sally_AbsoluteX();
-            sally_DEC();
-            break;
-        
-        case 0xe0:
-            sally_Immediate();
-            sally_CPX();
-            break;
-        
-        case 0xe1:
-            sally_IndirectX();
-            sally_SBC();
-            break;
-        
-        case 0xe4:
-            sally_ZeroPage();
-            sally_CPX();
-            break;
-        
-        case 0xe5:
-            sally_ZeroPage();
-            sally_SBC();
-            break;
-        
-        case 0xe6:
-            sally_ZeroPage();
-            sally_INC();
-            break;
-        
-        case 0xe8:
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xd9):
+            address = sally_AbsoluteY(operand.w);
+            sally_CMP(address);
+            cycles += sally_Delay(address, sally_y);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xdd):
+            address = sally_AbsoluteX(operand.w);
+            sally_CMP(address);
+            cycles += sally_Delay(address, sally_x);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xde):
+            address = sally_AbsoluteX(operand.w);
+            sally_DEC(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xe0):
+            address = sally_Immediate();
+            sally_CPX(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xe1):
+            address = sally_IndirectX(operand.w);
+            sally_SBC(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xe4):
+            address = sally_ZeroPage(operand.w);
+            sally_CPX(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xe5):
+            address = sally_ZeroPage(operand.w);
+            sally_SBC(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xe6):
+            address = sally_ZeroPage(operand.w);
+            sally_INC(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xe8):
             sally_INX();
-            break;
+            SALLY_NEXT;
         
-        case 0xe9:
-            sally_Immediate();
-            sally_SBC();
-            break;
+        SALLY_CASE(0xe9):
+            address = sally_Immediate();
+            sally_SBC(address);
+            SALLY_NEXT;
         
-        case 0xea:
+        SALLY_CASE(0xea):
             sally_NOP();
-            break;
-        
-        case 0xec:
-            sally_Absolute();
-            sally_CPX();
-            break;
-        
-        case 0xed:
-            sally_Absolute();
-            sally_SBC();
-            break;
-        
-        case 0xee:
-            sally_Absolute();
-            sally_INC();
-            break;
-        
-        case 0xf0:
-            sally_Relative();
-            sally_BEQ();
-            break;
-        
-        case 0xf1:
-            sally_IndirectY();
-            sally_SBC();
-            sally_Delay(sally_y);
-            break;
-        
-        case 0xf5:
-            sally_ZeroPageX();
-            sally_SBC();
-            break;
-        
-        case 0xf6:
-            sally_ZeroPageX();
-            sally_INC();
-            break;
-        
-        case 0xf8:
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xec):
+            address = sally_Absolute(operand.w);
+            sally_CPX(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xed):
+            address = sally_Absolute(operand.w);
+            sally_SBC(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xee):
+            address = sally_Absolute(operand.w);
+            sally_INC(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xf0):
+            address = sally_Relative(operand.w);
+            cycles += sally_BEQ(address);
+            SALLY_IDLE();
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xf1):
+            address = sally_IndirectY(operand.w);
+            sally_SBC(address);
+            cycles += sally_Delay(address, sally_y);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xf5):
+            address = sally_ZeroPageX(operand.w);
+            sally_SBC(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xf6):
+            address = sally_ZeroPageX(operand.w);
+            sally_INC(address);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xf8):
             sally_SED();
-            break;
-        
-        case 0xf9:
-            sally_AbsoluteY();
-            sally_SBC();
-            sally_Delay(sally_y);
-            break;
-        
-        case 0xfd:
-            sally_AbsoluteX();
-            sally_SBC();
-            sally_Delay(sally_x);
-            break;
-        
-        case 0xfe:
-            sally_AbsoluteX();
-            sally_INC();
-            break;
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xf9):
+            address = sally_AbsoluteY(operand.w);
+            sally_SBC(address);
+            cycles += sally_Delay(address, sally_y);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xfd):
+            address = sally_AbsoluteX(operand.w);
+            sally_SBC(address);
+            cycles += sally_Delay(address, sally_x);
+            SALLY_NEXT;
+        
+        SALLY_CASE(0xfe):
+            address = sally_AbsoluteX(operand.w);
+            sally_INC(address);
+            SALLY_NEXT;
+        
+        SALLY_DEFAULT:
+            SALLY_NEXT;
+#if SALLY_THREADED
+    }
+    
+sally_done:
+#else
+        }
         
-        default:
+        SALLY_RETIRE();
+        if (prosystem_cycles >= end || sally_stop) {
             break;
+        }
+    }
+#endif
+    return prosystem_cycles - start;
+}
+
+// Runs a single instruction and returns its length in CPU cycles. Like
+// sally_Run, this advances prosystem_cycles and prosystem_clock.
+uint32_t sally_ExecuteInstruction(void) {
+    uint32_t cycles = sally_Run(0);
+    
+    if (half_cycle) {
+        cycles -= 2;
+    }
+    return cycles >> 2;
+}
+
+void sally_Stop(void) {
+    sally_stop = true;
+}
+
+// Finds the slot for the decoded instructions of a page of ROM: one per
+// page of the cartridge image, then one per page of the BIOS. Returns
+// UINT32_MAX for anything else.
+static uint32_t sally_FindCode(const uint8_t* source) {
+    const uint8_t* cartridge = prosystem_current->cartridge.buffer;
+    uint32_t cartridgeSize = prosystem_current->cartridge.size;
+    const uint8_t* bios = prosystem_current->bios.data;
+    uint32_t biosSize = prosystem_current->bios.size;
+    uint32_t pages = (cartridgeSize + MEMORY_PAGE_SIZE - 1) / MEMORY_PAGE_SIZE;
+    
+    if (sally_codeTables == NULL) {
+        sally_codeTableCount = pages + (biosSize + MEMORY_PAGE_SIZE - 1) / MEMORY_PAGE_SIZE;
+        sally_codeTables = (sally_decoded**)calloc(sally_codeTableCount, sizeof(sally_decoded*));
+        sally_codeSources = (const uint8_t**)calloc(sally_codeTableCount, sizeof(const uint8_t*));
+        if (sally_codeTables == NULL || sally_codeSources == NULL) {
+            sally_ClearCode();
+            return UINT32_MAX;
+        }
+    }
+    
+    uint32_t index;
+    if (cartridge != NULL && source >= cartridge && source < cartridge + cartridgeSize) {
+        index = (source - cartridge) / MEMORY_PAGE_SIZE;
+    }
+    else if (bios != NULL && source >= bios && source < bios + biosSize) {
+        index = pages + (source - bios) / MEMORY_PAGE_SIZE;
+    }
+    else {
+        return UINT32_MAX;
+    }
+    return (index < sally_codeTableCount) ? index : UINT32_MAX;
+}
+
+// Points a page at its decoded instructions. source is the ROM the page is
+// mapped onto, or NULL if the page may change under the CPU and has to be
+// fetched through the bus. The instructions are kept with the page of ROM
+// they were decoded from, so a bank switch only swaps the pointer and
+// switching back to a bank does not decode it again.
+void sally_MapCode(uint8_t page, const uint8_t* source) {
+    sally_code[page] = NULL;
+    
+    if (source == NULL) {
+        return;
+    }
+    
+    uint32_t index = sally_FindCode(source);
+    if (index == UINT32_MAX) {
+        return;
+    }
+    
+    sally_decoded* code = sally_codeTables[index];
+    if (code == NULL) {
+        code = (sally_decoded*)calloc(MEMORY_PAGE_SIZE, sizeof(sally_decoded));
+        if (code == NULL) {
+            return;
+        }
+        sally_codeTables[index] = code;
+        sally_codeSources[index] = source;
+    }
+    else if (sally_codeSources[index] != source) {
+        // An image mapped off page boundaries, at a different offset
+        memset(code, 0, MEMORY_PAGE_SIZE * sizeof(sally_decoded));
+        sally_codeSources[index] = source;
+    }
+    sally_code[page] = code;
+}
+
+// Forgets every decoded instruction, for when the ROM images themselves
+// are replaced
+void sally_ClearCode(void) {
+    for (uint32_t page = 0; page < MEMORY_PAGE_COUNT; page++) {
+        sally_code[page] = NULL;
     }
     
-    return sally_cycles;
+    if (sally_codeTables != NULL) {
+        for (uint32_t index = 0; index < sally_codeTableCount; index++) {
+            free(sally_codeTables[index]);
+        }
+    }
+    free(sally_codeTables);
+    free(sally_codeSources);
+    sally_codeTables = NULL;
+    sally_codeSources = NULL;
+    sally_codeTableCount = 0;
+}
+
+// Switches between the decoded instruction cache and decoding every
+// instruction through the bus, for comparing the two. The cache is the
+// default.
+void sally_SetInterpreter(bool enabled) {
+    sally_interpret = enabled;
+}
+
+// Switches between crediting the passes of a wait loop at once and running
+// each of them, for comparing the two. Crediting them is the default.
+void sally_SetBusyWait(bool enabled) {
+    sally_busy = enabled;
+}
+
+void sally_Release(void) {
+    sally_ClearCode();
+}
+
+// The processor status with N and Z filled in
+uint8_t sally_GetStatus(void) {
+    uint8_t status = sally_p & ~(SALLY_FLAG.N | SALLY_FLAG.Z);
+    status |= sally_n & SALLY_FLAG.N;
+    if (!sally_z) {
+        status |= SALLY_FLAG.Z;
+    }
+    return status;
+}
+
+void sally_SetStatus(uint8_t status) {
+    sally_p = status;
+    sally_n = status;
+    sally_z = !(status & SALLY_FLAG.Z);
 }
 
 uint32_t sally_ExecuteRES(void) {
-    sally_p = SALLY_FLAG.I | SALLY_FLAG.R | SALLY_FLAG.Z;
-    sally_pc.b.l = memory_ram[SALLY_RES.L];
-    sally_pc.b.h = memory_ram[SALLY_RES.H];
+    sally_SetStatus(SALLY_FLAG.I | SALLY_FLAG.R | SALLY_FLAG.Z);
+    sally_pc.b.l = memory_Peek(SALLY_RES.L);
+    sally_pc.b.h = memory_Peek(SALLY_RES.H);
     return 6;
 }
 
@@ -1513,10 +1903,10 @@ uint32_t sally_ExecuteNMI(void) {
     sally_Push(sally_pc.b.h);
     sally_Push(sally_pc.b.l);
     sally_p &= ~SALLY_FLAG.B;
-    sally_Push(sally_p);
+    sally_Push(sally_GetStatus());
     sally_p |= SALLY_FLAG.I;
-    sally_pc.b.l = memory_ram[SALLY_NMI.L];
-    sally_pc.b.h = memory_ram[SALLY_NMI.H];
+    sally_pc.b.l = memory_Peek(SALLY_NMI.L);
+    sally_pc.b.h = memory_Peek(SALLY_NMI.H);
     return 7;
 }
 
@@ -1525,10 +1915,10 @@ uint32_t sally_ExecuteIRQ(void) {
         sally_Push(sally_pc.b.h);
         sally_Push(sally_pc.b.l);
         sally_p &= ~SALLY_FLAG.B;
-        sally_Push(sally_p);
+        sally_Push(sally_GetStatus());
         sally_p |= SALLY_FLAG.I;
-        sally_pc.b.l = memory_ram[SALLY_IRQ.L];
-        sally_pc.b.h = memory_ram[SALLY_IRQ.H];
+        sally_pc.b.l = memory_Peek(SALLY_IRQ.L);
+        sally_pc.b.h = memory_Peek(SALLY_IRQ.H);
     }
     return 7;
 }
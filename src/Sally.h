@@ -29,16 +29,62 @@
 #include "Memory.h"
 #include "Pair.h"
 
+// An instruction decoded from ROM: its opcode, operand and length in bytes.
+// A size of zero marks an entry that has not been decoded yet.
+typedef struct SallyDecoded {
+    uint8_t opcode;
+    uint8_t size;
+    pair operand;
+} sally_decoded;
+
+typedef struct SallyState {
+    uint8_t a;
+    uint8_t x;
+    uint8_t y;
+    uint8_t p;
+    uint8_t n;
+    uint8_t z;
+    uint8_t s;
+    pair pc;
+    bool halfCycle;
+    bool stop;
+    bool interpret;
+    bool busy;
+    sally_decoded* code[MEMORY_PAGE_COUNT];
+    sally_decoded** codeTables;
+    const uint8_t** codeSources;
+    uint32_t codeTableCount;
+} sally_state;
+
 extern void sally_Reset(void);
 extern uint32_t sally_ExecuteInstruction(void);
+extern uint32_t sally_Run(uint32_t budget);
+extern void sally_Stop(void);
+extern void sally_MapCode(uint8_t page, const uint8_t* source);
+extern void sally_ClearCode(void);
+extern void sally_SetInterpreter(bool enabled);
+extern void sally_SetBusyWait(bool enabled);
+extern void sally_Release(void);
+extern uint8_t sally_GetStatus(void);
+extern void sally_SetStatus(uint8_t status);
 extern uint32_t sally_ExecuteRES(void);
 extern uint32_t sally_ExecuteNMI(void);
 extern uint32_t sally_ExecuteIRQ(void);
-extern uint8_t sally_a;
-extern uint8_t sally_x;
-extern uint8_t sally_y;
-extern uint8_t sally_p;
-extern uint8_t sally_s;
-extern pair sally_pc;
+
+#define sally_a (prosystem_current->sally.a)
+#define sally_x (prosystem_current->sally.x)
+#define sally_y (prosystem_current->sally.y)
+// The N and Z bits of sally_p are not kept up to date while the CPU runs;
+// they are worked out from sally.n and sally.z. Read and write the status
+// through sally_GetStatus and sally_SetStatus instead.
+#define sally_p (prosystem_current->sally.p)
+#define sally_s (prosystem_current->sally.s)
+#define sally_pc (prosystem_current->sally.pc)
+
+// Whether the last operation resulted in a half cycle. (needs to be taken
+// into consideration by ProSystem when cycle counting). This can occur when
+// a TIA or RIOT are accessed (drops to 1.19Mhz when the TIA or RIOT chips
+// are accessed)
+#define half_cycle (prosystem_current->sally.halfCycle)
 
 #endif
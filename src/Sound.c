@@ -26,62 +26,614 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#if !defined(PROSYSTEM_NO_THREADS) && !defined(_WIN32)
+#define SOUND_THREADS
+#include <pthread.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "Sound.h"
 
-#define MAX_BUFFER_SIZE 8192
+#define nSamplesPerSec (prosystem_current->sound.samplesPerSec)
+#define sound_kernel (prosystem_current->sound.kernel)
+#define sound_thread (prosystem_current->sound.thread)
+#define sound_format (prosystem_current->sound.format)
+#define sound_stereo (prosystem_current->sound.stereo)
+#define sound_tiaPan (prosystem_current->sound.tiaPan)
+#define sound_pokeyPan (prosystem_current->sound.pokeyPan)
+
+// Samples mixed at a time
+#define SOUND_MIX_CHUNK 256
+
+// Mixed levels are in units of the 8-bit output, with SOUND_BLEP_SCALE bits
+// of fraction, so this is the level of silence in the signed formats
+#define SOUND_MIX_CENTER (128 << SOUND_BLEP_SCALE)
+
+// Entries that can be queued for the worker at once, a power of two, and
+// entries handed to it at a time
+#define SOUND_WRITE_COUNT 4096
+#define SOUND_WRITE_BATCH 64
+
+// A write to an audio register, made at the given cycle of the scanline.
+// For the end of a scanline, data is whether POKEY runs.
+typedef struct SoundWrite {
+    uint16_t address;
+    uint16_t cycle;
+    uint8_t kind;
+    uint8_t data;
+} sound_write;
+
+// Works out the band-limited steps: for each phase, a Blackman windowed
+// sinc cut off a little below the output Nyquist, centered that far past
+// the middle tap. Each phase's taps are rounded to add up to exactly one,
+// so levels come out exact once a step has settled.
+static void sound_MakeKernel(void) {
+    const double pi = 3.14159265358979323846;
+    const double cutoff = 0.9;
+    
+    for (int phase = 0; phase < SOUND_BLEP_PHASES; phase++) {
+        double taps[SOUND_BLEP_TAPS];
+        double total = 0.0;
+        
+        for (int tap = 0; tap < SOUND_BLEP_TAPS; tap++) {
+            double x = tap - ((SOUND_BLEP_TAPS / 2) - 1) - ((double)phase / SOUND_BLEP_PHASES);
+            double w = (x + (SOUND_BLEP_TAPS / 2)) / SOUND_BLEP_TAPS;
+            double window = 0.42 - (0.5 * cos(2.0 * pi * w)) + (0.08 * cos(4.0 * pi * w));
+            double sinc = (x == 0.0)? 1.0: sin(pi * cutoff * x) / (pi * cutoff * x);
+            
+            taps[tap] = (w > 0.0 && w < 1.0)? window * sinc: 0.0;
+            total += taps[tap];
+        }
+        
+        int32_t sum = 0;
+        int center = SOUND_BLEP_TAPS / 2;
+        for (int tap = 0; tap < SOUND_BLEP_TAPS; tap++) {
+            sound_kernel[phase][tap] = (int16_t)lrint((taps[tap] / total) * (1 << SOUND_BLEP_SCALE));
+            sum += sound_kernel[phase][tap];
+            if (taps[tap] > taps[center]) {
+                center = tap;
+            }
+        }
+        sound_kernel[phase][center] += (1 << SOUND_BLEP_SCALE) - sum;
+    }
+}
+
+static void sound_ClearBlep(sound_blep* blep, int32_t level) {
+    memset(blep->buffer, 0, sizeof(blep->buffer));
+    blep->sum = level << SOUND_BLEP_SCALE;
+    blep->level = level;
+}
+
+void sound_Reset(void) {
+    sound_MakeKernel();
+    sound_ClearBlep(&sound_tia, 0);
+    
+    // POKEY rests at a level of 8 with all channels quiet
+    sound_ClearBlep(&sound_pokey, 8);
+}
+
+// Sets the source's level from the given time on. Times are in samples at
+// the source rate of two per scanline, counted from the start of the frame,
+// with 16 bits of fraction. The change is placed at its exact position
+// between output samples, and takes effect SOUND_BLEP_TAPS / 2 - 1 samples
+// late.
+void sound_Level(sound_blep* blep, uint32_t time, int32_t level) {
+    int32_t delta = level - blep->level;
+    
+    if (delta == 0) {
+        return;
+    }
+    blep->level = level;
+    
+    uint32_t length = nSamplesPerSec / prosystem_frequency;
+    uint64_t position = ((uint64_t)time * length) / ((uint32_t)prosystem_scanlines << 1);
+    uint32_t index = (uint32_t)(position >> 16);
+    const int16_t* kernel = sound_kernel[((position & 0xffff) * SOUND_BLEP_PHASES) >> 16];
+    
+    if (index >= SOUND_BUFFER_SIZE) {
+        index = SOUND_BUFFER_SIZE - 1;
+    }
+    
+    int32_t* buffer = blep->buffer + index;
+    for (int tap = 0; tap < SOUND_BLEP_TAPS; tap++) {
+        buffer[tap] += kernel[tap] * delta;
+    }
+}
+
+// Adds up the frame's length samples of the source into levels, in place
+static void sound_ReadBlep(sound_blep* blep, uint32_t length) {
+    int32_t sum = blep->sum;
+    
+    for (uint32_t index = 0; index < length; index++) {
+        sum += blep->buffer[index];
+        blep->buffer[index] = sum;
+    }
+    blep->sum = sum;
+}
+
+// Keeps what spilled past the frame's length samples for the next frame
+static void sound_SpillBlep(sound_blep* blep, uint32_t length) {
+    memmove(blep->buffer, blep->buffer + length, SOUND_BLEP_TAPS * sizeof(int32_t));
+    memset(blep->buffer + SOUND_BLEP_TAPS, 0, length * sizeof(int32_t));
+}
+
+// Mixes the two sources with weights out of 64
+static inline void sound_Mix(int32_t* mix, const int32_t* tia, const int32_t* pokey, int32_t tiaWeight, int32_t pokeyWeight, uint32_t length) {
+    uint32_t index = 0;
+    
+#if defined(__SSE2__)
+    // SSE2 has no 32-bit multiply, so each level is split at bit 15 into
+    // two parts that fit 16 bits, and one multiply-add per part weighs a
+    // TIA sample and a POKEY sample together. The sum is exact.
+    const __m128i weights = _mm_set1_epi32((pokeyWeight << 16) | (tiaWeight & 0xffff));
+    const __m128i low = _mm_set1_epi32(0x7fff);
+    const __m128i half = _mm_set1_epi32(0xffff);
+    
+    for (; index + 4 <= length; index += 4) {
+        __m128i t = _mm_loadu_si128((const __m128i*)(tia + index));
+        __m128i p = _mm_loadu_si128((const __m128i*)(pokey + index));
+        __m128i lows = _mm_or_si128(_mm_and_si128(t, low), _mm_slli_epi32(_mm_and_si128(p, low), 16));
+        __m128i highs = _mm_or_si128(_mm_and_si128(_mm_srai_epi32(t, 15), half), _mm_slli_epi32(_mm_srai_epi32(p, 15), 16));
+        __m128i sum = _mm_add_epi32(_mm_slli_epi32(_mm_madd_epi16(highs, weights), 15), _mm_madd_epi16(lows, weights));
+        _mm_storeu_si128((__m128i*)(mix + index), _mm_srai_epi32(sum, 6));
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    const int32x4_t tiaWeights = vdupq_n_s32(tiaWeight);
+    const int32x4_t pokeyWeights = vdupq_n_s32(pokeyWeight);
+    
+    for (; index + 4 <= length; index += 4) {
+        int32x4_t t = vmulq_s32(vld1q_s32(tia + index), tiaWeights);
+        vst1q_s32(mix + index, vshrq_n_s32(vmlaq_s32(t, vld1q_s32(pokey + index), pokeyWeights), 6));
+    }
+#endif
+    for (; index < length; index++) {
+        mix[index] = ((tia[index] * tiaWeight) + (pokey[index] * pokeyWeight)) >> 6;
+    }
+}
+
+static inline int16_t sound_ToS16(int32_t level) {
+    int32_t sample = (level - SOUND_MIX_CENTER) >> (SOUND_BLEP_SCALE - 8);
+    return (sample < -32768)? -32768: (sample > 32767)? 32767: (int16_t)sample;
+}
+
+static inline float sound_ToF32(int32_t level) {
+    float sample = (float)(level - SOUND_MIX_CENTER) * (1.0f / SOUND_MIX_CENTER);
+    return (sample < -1.0f)? -1.0f: (sample > 1.0f)? 1.0f: sample;
+}
+
+static inline uint8_t sound_ToU8(int32_t level) {
+    int32_t sample = level >> SOUND_BLEP_SCALE;
+    return (sample < 0)? 0: (sample > 255)? 255: (uint8_t)sample;
+}
+
+#if defined(__SSE2__)
+// Eight mixed levels as saturated 16-bit samples, shifted down by shift
+// after taking away center
+static inline __m128i sound_Pack16(const int32_t* mix, int32_t center, int shift) {
+    const __m128i offset = _mm_set1_epi32(center);
+    __m128i first = _mm_sra_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i*)mix), offset), _mm_cvtsi32_si128(shift));
+    __m128i second = _mm_sra_epi32(_mm_sub_epi32(_mm_loadu_si128((const __m128i*)(mix + 4)), offset), _mm_cvtsi32_si128(shift));
+    return _mm_packs_epi32(first, second);
+}
+
+// Four mixed levels as float samples, clamped to [-1, 1]
+static inline __m128 sound_PackF32(const int32_t* mix) {
+    __m128 sample = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_loadu_si128((const __m128i*)mix), _mm_set1_epi32(SOUND_MIX_CENTER)));
+    sample = _mm_mul_ps(sample, _mm_set1_ps(1.0f / SOUND_MIX_CENTER));
+    return _mm_min_ps(_mm_max_ps(sample, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+}
+#endif
+
+// Writes mixed levels to out in the given format, interleaving the right
+// channel's if there is one. The packing instructions saturate the same
+// way the per-sample clamps do, so both paths write the same samples.
+static void sound_Convert(void* out, const int32_t* left, const int32_t* right, uint32_t length, uint8_t format) {
+    uint32_t stride = (right != NULL)? 2: 1;
+    uint32_t index = 0;
+    
+    switch (format) {
+        case SOUND_FORMAT_S16: {
+            int16_t* samples = (int16_t*)out;
+#if defined(__SSE2__)
+            for (; index + 8 <= length; index += 8) {
+                __m128i l = sound_Pack16(left + index, SOUND_MIX_CENTER, SOUND_BLEP_SCALE - 8);
+                if (right == NULL) {
+                    _mm_storeu_si128((__m128i*)(samples + index), l);
+                    continue;
+                }
+                __m128i r = sound_Pack16(right + index, SOUND_MIX_CENTER, SOUND_BLEP_SCALE - 8);
+                _mm_storeu_si128((__m128i*)(samples + (index * 2)), _mm_unpacklo_epi16(l, r));
+                _mm_storeu_si128((__m128i*)(samples + (index * 2) + 8), _mm_unpackhi_epi16(l, r));
+            }
+#endif
+            for (; index < length; index++) {
+                samples[index * stride] = sound_ToS16(left[index]);
+                if (right != NULL) {
+                    samples[(index * stride) + 1] = sound_ToS16(right[index]);
+                }
+            }
+            break;
+        }
+        
+        case SOUND_FORMAT_F32: {
+            float* samples = (float*)out;
+#if defined(__SSE2__)
+            for (; index + 4 <= length; index += 4) {
+                __m128 l = sound_PackF32(left + index);
+                if (right == NULL) {
+                    _mm_storeu_ps(samples + index, l);
+                    continue;
+                }
+                __m128 r = sound_PackF32(right + index);
+                _mm_storeu_ps(samples + (index * 2), _mm_unpacklo_ps(l, r));
+                _mm_storeu_ps(samples + (index * 2) + 4, _mm_unpackhi_ps(l, r));
+            }
+#endif
+            for (; index < length; index++) {
+                samples[index * stride] = sound_ToF32(left[index]);
+                if (right != NULL) {
+                    samples[(index * stride) + 1] = sound_ToF32(right[index]);
+                }
+            }
+            break;
+        }
+        
+        default: {
+            uint8_t* samples = (uint8_t*)out;
+#if defined(__SSE2__)
+            for (; index + 8 <= length; index += 8) {
+                __m128i l = sound_Pack16(left + index, 0, SOUND_BLEP_SCALE);
+                if (right == NULL) {
+                    _mm_storel_epi64((__m128i*)(samples + index), _mm_packus_epi16(l, l));
+                    continue;
+                }
+                __m128i r = sound_Pack16(right + index, 0, SOUND_BLEP_SCALE);
+                _mm_storeu_si128((__m128i*)(samples + (index * 2)), _mm_packus_epi16(_mm_unpacklo_epi16(l, r), _mm_unpackhi_epi16(l, r)));
+            }
+#endif
+            for (; index < length; index++) {
+                samples[index * stride] = sound_ToU8(left[index]);
+                if (right != NULL) {
+                    samples[(index * stride) + 1] = sound_ToU8(right[index]);
+                }
+            }
+            break;
+        }
+    }
+}
+
+// A source's weight on one side: its full weight, cut back as it is panned
+// toward the other side
+static inline int32_t sound_GetWeight(int32_t weight, int8_t pan, int8_t side) {
+    int32_t share = SOUND_PAN_LIMIT + (pan * side);
+    return (weight * ((share > SOUND_PAN_LIMIT)? SOUND_PAN_LIMIT: share)) / SOUND_PAN_LIMIT;
+}
+
+static void sound_Apply(const sound_write* write) {
+    switch (write->kind) {
+        case SOUND_WRITE_TIA:
+            tia_Write(write->address, write->data);
+            break;
+        
+        case SOUND_WRITE_POKEY:
+            pokey_Write(write->address, write->data, write->cycle);
+            break;
+        
+        case SOUND_WRITE_SCANLINE:
+            tia_Process(2);
+            
+            if (write->data) {
+                pokey_Process(2);
+            }
+            break;
+    }
+}
 
-static uint32_t nSamplesPerSec = 48000;
+#if defined(SOUND_THREADS)
+// The write log, played back on a worker thread. As with Maria's worker,
+// the scanline loop fills in entries from head on and hands them over
+// SOUND_WRITE_BATCH at a time by moving head past them; the worker applies
+// the entries from tail up to head and moves tail on. Both only ever count
+// up. seen is tail as the scanline loop last saw it.
+struct SoundWorker {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t queued;
+    pthread_cond_t played;
+    prosystem_context* context;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t pending;
+    uint32_t seen;
+    bool quit;
+    sound_write writes[SOUND_WRITE_COUNT];
+};
 
-static void sound_Resample(const uint8_t *source, uint8_t *target, int length) {
-    int measurement = nSamplesPerSec;
-    int sourceIndex = 0;
-    int targetIndex = 0;
-    int max = ((prosystem_frequency * prosystem_scanlines) << 1);
+static void* sound_Work(void* argument) {
+    sound_worker* worker = (sound_worker*)argument;
+    
+    // TIA and POKEY find their state through the context
+    prosystem_current = worker->context;
     
-    while (targetIndex < length) {
-        if (measurement >= max) {
-            target[targetIndex++] = source[sourceIndex];
-            measurement -= max;
+    pthread_mutex_lock(&worker->mutex);
+    for (;;) {
+        while (worker->tail == worker->head && !worker->quit) {
+            pthread_cond_wait(&worker->queued, &worker->mutex);
         }
-        else {
-            ++sourceIndex;
-            measurement += nSamplesPerSec;
+        
+        uint32_t tail = worker->tail;
+        uint32_t head = worker->head;
+        if (tail == head) {
+            break;
+        }
+        
+        pthread_mutex_unlock(&worker->mutex);
+        for (; tail != head; tail++) {
+            sound_Apply(&worker->writes[tail % SOUND_WRITE_COUNT]);
+        }
+        pthread_mutex_lock(&worker->mutex);
+        
+        worker->tail = tail;
+        pthread_cond_signal(&worker->played);
+    }
+    pthread_mutex_unlock(&worker->mutex);
+    return NULL;
+}
+
+static sound_worker* sound_StartWorker(prosystem_context* context) {
+    sound_worker* worker = (sound_worker*)calloc(1, sizeof(sound_worker));
+    if (worker == NULL) {
+        return NULL;
+    }
+    
+    worker->context = context;
+    pthread_mutex_init(&worker->mutex, NULL);
+    pthread_cond_init(&worker->queued, NULL);
+    pthread_cond_init(&worker->played, NULL);
+    if (pthread_create(&worker->thread, NULL, sound_Work, worker)) {
+        pthread_cond_destroy(&worker->played);
+        pthread_cond_destroy(&worker->queued);
+        pthread_mutex_destroy(&worker->mutex);
+        free(worker);
+        return NULL;
+    }
+    return worker;
+}
+
+// Hands the pending entries to the worker. Called with the mutex held.
+static inline void sound_PublishWrites(sound_worker* worker) {
+    worker->seen = worker->tail;
+    if (worker->pending > 0) {
+        worker->head += worker->pending;
+        worker->pending = 0;
+        pthread_cond_signal(&worker->queued);
+    }
+}
+
+// Hands over every pending entry and waits for all of them to be applied
+static void sound_DrainWorker(sound_worker* worker) {
+    pthread_mutex_lock(&worker->mutex);
+    sound_PublishWrites(worker);
+    while (worker->tail != worker->head) {
+        pthread_cond_wait(&worker->played, &worker->mutex);
+    }
+    pthread_mutex_unlock(&worker->mutex);
+}
+
+// Applies whatever is still queued, then ends the thread
+static void sound_StopWorker(sound_worker* worker) {
+    sound_DrainWorker(worker);
+    
+    pthread_mutex_lock(&worker->mutex);
+    worker->quit = true;
+    pthread_cond_signal(&worker->queued);
+    pthread_mutex_unlock(&worker->mutex);
+    
+    pthread_join(worker->thread, NULL);
+    pthread_cond_destroy(&worker->played);
+    pthread_cond_destroy(&worker->queued);
+    pthread_mutex_destroy(&worker->mutex);
+    free(worker);
+}
+
+// The next free entry, waiting for the worker if the log is full
+static sound_write* sound_ReserveWrite(sound_worker* worker) {
+    if (worker->head + worker->pending - worker->seen >= SOUND_WRITE_COUNT) {
+        pthread_mutex_lock(&worker->mutex);
+        sound_PublishWrites(worker);
+        while (worker->head - worker->tail == SOUND_WRITE_COUNT) {
+            pthread_cond_wait(&worker->played, &worker->mutex);
         }
+        worker->seen = worker->tail;
+        pthread_mutex_unlock(&worker->mutex);
+    }
+    return &worker->writes[(worker->head + worker->pending) % SOUND_WRITE_COUNT];
+}
+
+static void sound_QueueWrite(sound_worker* worker) {
+    if (++worker->pending == SOUND_WRITE_BATCH) {
+        pthread_mutex_lock(&worker->mutex);
+        sound_PublishWrites(worker);
+        pthread_mutex_unlock(&worker->mutex);
+    }
+}
+#endif
+
+// Writes to a TIA or POKEY audio register as of the current cycle. The
+// write is logged for the worker, or else applied now.
+void sound_Write(uint8_t kind, uint16_t address, uint8_t data) {
+    sound_write local;
+    sound_write* write = &local;
+    
+#if defined(SOUND_THREADS)
+    if (sound_thread != NULL) {
+        write = sound_ReserveWrite(sound_thread);
+    }
+#endif
+    write->address = address;
+    write->cycle = (prosystem_cycles < CYCLES_PER_SCANLINE)? prosystem_cycles: CYCLES_PER_SCANLINE;
+    write->kind = kind;
+    write->data = data;
+    
+#if defined(SOUND_THREADS)
+    if (sound_thread != NULL) {
+        sound_QueueWrite(sound_thread);
+        return;
     }
+#endif
+    sound_Apply(write);
 }
 
-uint32_t sound_Store(uint8_t *out_buffer) {
-    memset(out_buffer, 0, MAX_BUFFER_SIZE);
+// Ends the scanline, storing its samples
+void sound_Scanline(bool pokey) {
+    sound_Write(SOUND_WRITE_SCANLINE, 0, pokey);
+}
+
+// Writes the frame's audio to out_buffer, which must hold
+// sound_GetBufferSize() bytes, and returns how many samples were written
+// to each channel
+uint32_t sound_Store(void *out_buffer) {
+    sound_Flush();
     uint32_t length = nSamplesPerSec / prosystem_frequency;
-    sound_Resample(tia_buffer, out_buffer, length);
+    if (length > SOUND_BUFFER_SIZE) {
+        length = SOUND_BUFFER_SIZE;
+    }
+    
+    const int32_t* tia = sound_tia.buffer;
+    const int32_t* pokey = sound_pokey.buffer;
+    sound_ReadBlep(&sound_tia, length);
+    sound_ReadBlep(&sound_pokey, length);
     tia_Clear();
     
     // Ballblazer, Commando, various homebrew and hacks
+    int32_t tiaWeight = 48;
+    int32_t pokeyWeight = 0;
     if(cartridge_pokey || xm_pokey_enabled) {
-        uint8_t pokeySample[MAX_BUFFER_SIZE];
-        memset(pokeySample, 0, MAX_BUFFER_SIZE);
-        sound_Resample(pokey_buffer, pokeySample, length);
-        
-        for(uint32_t index = 0; index < length; ++index) {
-            uint32_t sound = out_buffer[index] + pokeySample[index];
-            out_buffer[index] = sound >> 1;
-        }
+        tiaWeight = 32;
+        pokeyWeight = 32;
+    }
+    
+    uint32_t channels = sound_stereo? 2: 1;
+    int32_t tiaSide[2];
+    int32_t pokeySide[2];
+    for (uint32_t channel = 0; channel < channels; channel++) {
+        int8_t side = (channels == 1)? 0: (channel == 0)? -1: 1;
+        tiaSide[channel] = sound_GetWeight(tiaWeight, sound_tiaPan, side);
+        pokeySide[channel] = sound_GetWeight(pokeyWeight, sound_pokeyPan, side);
     }
-    else {
-        for(uint32_t index = 0; index < length; ++index) {
-            out_buffer[index] = out_buffer[index] * 0.75; //>> 1;
+    
+    uint8_t* out = (uint8_t*)out_buffer;
+    uint32_t size = sound_GetSampleSize();
+    for (uint32_t index = 0; index < length; index += SOUND_MIX_CHUNK) {
+        int32_t mix[2][SOUND_MIX_CHUNK];
+        uint32_t count = (length - index < SOUND_MIX_CHUNK)? length - index: SOUND_MIX_CHUNK;
+        
+        for (uint32_t channel = 0; channel < channels; channel++) {
+            sound_Mix(mix[channel], tia + index, pokey + index, tiaSide[channel], pokeySide[channel], count);
         }
+        sound_Convert(out + (index * size), mix[0], (channels == 2)? mix[1]: NULL, count, sound_format);
     }
     pokey_Clear();
+    sound_SpillBlep(&sound_tia, length);
+    sound_SpillBlep(&sound_pokey, length);
     
     return length;
 }
 
 void sound_SetSampleRate(uint32_t rate) {
+    sound_Flush();
     nSamplesPerSec = rate;
 }
 
 uint32_t sound_GetSampleRate(void) {
     return nSamplesPerSec;
 }
+
+// Sets what sound_Store writes. Stereo samples are interleaved, left first.
+void sound_SetFormat(uint8_t format, bool stereo) {
+    sound_format = (format <= SOUND_FORMAT_F32)? format: SOUND_FORMAT_U8;
+    sound_stereo = stereo;
+}
+
+uint8_t sound_GetFormat(void) {
+    return sound_format;
+}
+
+bool sound_IsStereo(void) {
+    return sound_stereo;
+}
+
+// The size in bytes of one sample on every channel
+uint32_t sound_GetSampleSize(void) {
+    uint32_t size = (sound_format == SOUND_FORMAT_F32)? 4: (sound_format == SOUND_FORMAT_S16)? 2: 1;
+    return sound_stereo? size * 2: size;
+}
+
+// The most sound_Store can write for a frame, in bytes
+uint32_t sound_GetBufferSize(void) {
+    return SOUND_BUFFER_SIZE * sound_GetSampleSize();
+}
+
+// Pans TIA and POKEY, the cartridge's or the expansion module's, in
+// stereo output. Mono output is the same at any pan.
+void sound_SetPan(int8_t tia, int8_t pokey) {
+    sound_tiaPan = (tia < -SOUND_PAN_LIMIT)? -SOUND_PAN_LIMIT: (tia > SOUND_PAN_LIMIT)? SOUND_PAN_LIMIT: tia;
+    sound_pokeyPan = (pokey < -SOUND_PAN_LIMIT)? -SOUND_PAN_LIMIT: (pokey > SOUND_PAN_LIMIT)? SOUND_PAN_LIMIT: pokey;
+}
+
+// With threaded set, TIA and POKEY run on a thread of their own, playing
+// back a log of the audio register writes the CPU makes and where each
+// scanline ends. Everything the CPU reads back, the pots and RANDOM, stays
+// with the CPU. The thread may still be working on a frame when
+// prosystem_ExecuteFrame returns; sound_Store waits for it, so the output is
+// the same either way. Returns whether audio
+// is now made on the thread, which is never the case on builds without
+// threads.
+bool sound_SetThreaded(bool threaded) {
+#if defined(SOUND_THREADS)
+    if (threaded && sound_thread == NULL) {
+        sound_thread = sound_StartWorker(prosystem_current);
+    }
+    else if (!threaded && sound_thread != NULL) {
+        sound_StopWorker(sound_thread);
+        sound_thread = NULL;
+    }
+    return sound_thread != NULL;
+#else
+    return false;
+#endif
+}
+
+// Hands the rest of the frame's entries to the thread without waiting for
+// them, so the thread finishes the frame while the caller moves on. The
+// wait is left to sound_Store.
+void sound_EndFrame(void) {
+#if defined(SOUND_THREADS)
+    if (sound_thread != NULL && sound_thread->pending > 0) {
+        pthread_mutex_lock(&sound_thread->mutex);
+        sound_PublishWrites(sound_thread);
+        pthread_mutex_unlock(&sound_thread->mutex);
+    }
+#endif
+}
+
+// Waits until every entry handed to the thread has been applied
+void sound_Flush(void) {
+#if defined(SOUND_THREADS)
+    if (sound_thread != NULL) {
+        sound_DrainWorker(sound_thread);
+    }
+#endif
+}
+
+void sound_Release(void) {
+    sound_SetThreaded(false);
+}
@@ -26,13 +26,77 @@
 #ifndef SOUND_H
 #define SOUND_H
 
+#define SOUND_BUFFER_SIZE 8192
+
+// Each level change is spread over SOUND_BLEP_TAPS output samples, by one of
+// SOUND_BLEP_PHASES band-limited steps chosen by where it falls between two
+// output samples
+#define SOUND_BLEP_TAPS 16
+#define SOUND_BLEP_PHASES 64
+#define SOUND_BLEP_SCALE 15
+
+// The level changes of one sound source, at the output rate. Samples are
+// the running sum of buffer, in units of 1 << SOUND_BLEP_SCALE, continuing
+// from sum; level is the source's level as last given.
+typedef struct SoundBlep {
+    int32_t buffer[SOUND_BUFFER_SIZE + SOUND_BLEP_TAPS];
+    int32_t sum;
+    int32_t level;
+} sound_blep;
+
+// What an entry in the write log holds: a write to a TIA or POKEY audio
+// register, or the end of a scanline
+#define SOUND_WRITE_TIA 0
+#define SOUND_WRITE_POKEY 1
+#define SOUND_WRITE_SCANLINE 2
+
+// Sample formats sound_Store can write: unsigned 8-bit, signed 16-bit in
+// host byte order, or 32-bit float from -1 to 1
+#define SOUND_FORMAT_U8 0
+#define SOUND_FORMAT_S16 1
+#define SOUND_FORMAT_F32 2
+
+// Pans run from -SOUND_PAN_LIMIT, left only, to SOUND_PAN_LIMIT, right only
+#define SOUND_PAN_LIMIT 16
+
+typedef struct SoundWorker sound_worker;
+
+typedef struct SoundState {
+    uint32_t samplesPerSec;
+    uint8_t format;
+    bool stereo;
+    int8_t tiaPan;
+    int8_t pokeyPan;
+    int16_t kernel[SOUND_BLEP_PHASES][SOUND_BLEP_TAPS];
+    sound_blep tia;
+    sound_blep pokey;
+    sound_worker* thread;
+} sound_state;
+
 #include "ProSystem.h"
 #include "Tia.h"
 #include "Pokey.h"
 #include "Cartridge.h"
 
-extern uint32_t sound_Store(uint8_t *out_buffer);
+extern void sound_Reset(void);
+extern void sound_Level(sound_blep* blep, uint32_t time, int32_t level);
+extern void sound_Write(uint8_t kind, uint16_t address, uint8_t data);
+extern void sound_Scanline(bool pokey);
+extern bool sound_SetThreaded(bool threaded);
+extern void sound_EndFrame(void);
+extern void sound_Flush(void);
+extern void sound_Release(void);
+extern uint32_t sound_Store(void *out_buffer);
 extern void sound_SetSampleRate(uint32_t rate);
 extern uint32_t sound_GetSampleRate(void);
+extern void sound_SetFormat(uint8_t format, bool stereo);
+extern uint8_t sound_GetFormat(void);
+extern bool sound_IsStereo(void);
+extern uint32_t sound_GetSampleSize(void);
+extern uint32_t sound_GetBufferSize(void);
+extern void sound_SetPan(int8_t tia, int8_t pokey);
+
+#define sound_tia (prosystem_current->sound.tia)
+#define sound_pokey (prosystem_current->sound.pokey)
 
 #endif
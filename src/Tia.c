@@ -41,31 +41,51 @@
 // ----------------------------------------------------------------------------
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 
 #include "Tia.h"
+#include "ProSystem.h"
+#include "Sound.h"
 #define TIA_POLY4_SIZE 15
 #define TIA_POLY5_SIZE 31
 #define TIA_POLY9_SIZE 511
 
-uint8_t tia_buffer[TIA_BUFFER_SIZE] = {0};
-uint32_t tia_size = TIA_BUFFER_SIZE; // previously was 524
-
 static const uint8_t TIA_POLY4[] = {1,1,0,1,1,1,0,0,0,0,1,0,1,0,0};
 static const uint8_t TIA_POLY5[] = {0,0,1,0,1,1,0,0,1,1,1,1,1,0,0,0,1,1,0,1,1,1,0,1,0,1,0,0,0,0,1};
 static const uint8_t TIA_POLY9[] = {0,0,1,0,1,0,0,0,1,0,0,0,0,0,0,0,1,0,1,1,1,0,0,1,0,1,0,0,1,1,1,1,1,0,0,1,1,0,1,1,0,1,0,1,1,1,0,1,1,0,0,1,0,0,1,1,1,1,0,1,0,0,0,0,1,1,0,1,1,0,0,0,1,0,0,0,1,1,1,1,0,1,0,1,1,0,1,0,1,0,0,0,0,1,1,0,1,0,1,0,0,0,1,0,1,0,0,0,1,1,1,0,0,1,1,0,1,1,0,0,1,1,1,1,1,0,0,1,1,0,0,0,1,1,0,1,0,0,0,1,1,0,0,1,1,1,1,0,0,1,0,0,0,1,1,1,0,0,1,1,0,1,0,1,1,0,1,1,0,1,0,0,1,0,0,1,1,1,1,1,1,0,1,1,1,1,0,1,1,0,0,0,0,1,1,1,1,1,0,0,0,1,0,0,0,0,1,0,0,0,1,0,1,0,1,1,0,0,0,0,1,0,1,1,1,1,0,1,0,0,0,1,1,0,0,0,1,1,1,0,1,1,1,0,1,0,0,0,0,0,0,0,0,1,0,1,0,0,1,0,0,0,0,1,1,1,0,0,0,1,1,1,0,0,1,1,0,0,1,0,0,1,0,1,1,0,0,0,0,1,0,0,0,1,0,0,0,1,0,1,1,1,1,0,0,0,1,1,1,0,0,0,1,0,0,1,1,1,1,0,1,1,1,1,1,1,1,0,1,1,1,1,1,1,0,1,1,0,1,0,1,1,1,1,0,0,1,0,1,0,1,1,1,0,0,0,0,0,1,1,0,1,1,0,0,0,1,0,1,0,1,0,0,0,0,1,0,1,1,1,0,0,0,0,1,0,0,1,0,1,0,0,0,1,0,1,1,1,0,0,1,1,1,1,1,1,1,0,0,0,0,0,1,0,0,1,1,0,1,0,0,1,0,0,0,1,0,0,1,0,1,0,0,0,1,1,0,1,0,0,0,0,0,1,1,1,1,0,0,1,0,0,1,0,1,1,1,1,1,1,1,0,1,0,0,1,0,0,0,1,1,0,1,1,1,0,0,0,1,0,1,0,0,1,0,1,0,1,0,1,1,1,0,0,1,0,1,1,0,0,1,1,1,1,1,0,0,0,1,1,0};
 static const uint8_t TIA_DIV31[] = {1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,0,0,0,0,0,0,0,0,0,0,0,0};
-static uint8_t tia_volume[2] = {0};
-static uint8_t tia_counterMax[2] = {0};
-static uint8_t tia_counter[2] = {0};
-static uint8_t tia_audc[2] = {0};
-static uint8_t tia_audf[2] = {0};
-static uint8_t tia_audv[2] = {0};
-static uint32_t tia_poly4Cntr[2] = {0};
-static uint32_t tia_poly5Cntr[2] = {0};
-static uint32_t tia_poly9Cntr[2] = {0};
-static uint32_t tia_soundCntr = 0;
 
-static void tia_ProcessChannel(uint8_t channel) {
+// Steps after which each AUDC value's output repeats. The poly5 counter
+// always steps and the poly9 counter steps for AUDC 8, but neither matters
+// to the output of the other values, so they are not counted in.
+static const uint16_t TIA_PERIOD[16] = {0, 15, 465, 465, 2, 2, 31, 31, 511, 31, 31, 31, 2, 2, 31, 31};
+
+// Samples worked out at a time by tia_Process
+#define TIA_CHUNK_SIZE 64
+
+#define tia_volume (prosystem_current->tia.volume)
+#define tia_counterMax (prosystem_current->tia.counterMax)
+#define tia_counter (prosystem_current->tia.counter)
+#define tia_audc (prosystem_current->tia.audc)
+#define tia_audf (prosystem_current->tia.audf)
+#define tia_audv (prosystem_current->tia.audv)
+#define tia_poly4Cntr (prosystem_current->tia.poly4Cntr)
+#define tia_poly5Cntr (prosystem_current->tia.poly5Cntr)
+#define tia_poly9Cntr (prosystem_current->tia.poly9Cntr)
+#define tia_soundCntr (prosystem_current->tia.soundCntr)
+#define tia_wave (prosystem_current->tia.wave)
+#define tia_waveLength (prosystem_current->tia.waveLength)
+#define tia_waveFilled (prosystem_current->tia.waveFilled)
+#define tia_wavePosition (prosystem_current->tia.wavePosition)
+#define tia_waveVolume (prosystem_current->tia.waveVolume)
+#define tia_wavePoly4 (prosystem_current->tia.wavePoly4)
+#define tia_wavePoly5 (prosystem_current->tia.wavePoly5)
+#define tia_wavePoly9 (prosystem_current->tia.wavePoly9)
+
+// Steps the channel, returning whether its output was worked out afresh
+// rather than left as it was
+static bool tia_ProcessChannel(uint8_t channel) {
     tia_poly5Cntr[channel]++;
     
     if (tia_poly5Cntr[channel] == TIA_POLY5_SIZE) {
@@ -99,6 +119,98 @@ static void tia_ProcessChannel(uint8_t channel) {
             
             tia_volume[channel] = (TIA_POLY4[tia_poly4Cntr[channel]])? tia_audv[channel]: 0;
         }
+        return true;
+    }
+    return false;
+}
+
+// Notes the channel's counters at the step just taken, which starts the
+// period recorded from the next sample on. The step must have worked out
+// the output, since until then it may be left from other settings.
+static void tia_StartWave(uint8_t channel) {
+    tia_waveLength[channel] = TIA_PERIOD[tia_audc[channel]] * tia_counterMax[channel];
+    tia_waveFilled[channel] = 0;
+    tia_wavePosition[channel] = 0;
+    tia_waveVolume[channel] = tia_volume[channel];
+    tia_wavePoly4[channel] = tia_poly4Cntr[channel];
+    tia_wavePoly5[channel] = tia_poly5Cntr[channel];
+    tia_wavePoly9[channel] = tia_poly9Cntr[channel];
+}
+
+// Drops the channel's recorded period. One that is being played back first
+// has the counters put back to where stepping would have left them.
+static void tia_ClearWave(uint8_t channel) {
+    uint16_t length = tia_waveLength[channel];
+    
+    if (length != 0 && tia_waveFilled[channel] == length) {
+        uint16_t position = tia_wavePosition[channel];
+        uint8_t counter = tia_counterMax[channel];
+        
+        tia_volume[channel] = tia_waveVolume[channel];
+        tia_poly4Cntr[channel] = tia_wavePoly4[channel];
+        tia_poly5Cntr[channel] = tia_wavePoly5[channel];
+        tia_poly9Cntr[channel] = tia_wavePoly9[channel];
+        for (uint16_t step = position / counter; step > 0; step--) {
+            tia_ProcessChannel(channel);
+        }
+        tia_counter[channel] = counter - (position % counter);
+    }
+    tia_waveLength[channel] = 0;
+}
+
+// Works out the channel's next samples. They are stepped one at a time
+// until the channel has been recorded for a whole period, and copied from
+// the recording after that.
+static void tia_ProcessWave(uint8_t channel, uint8_t* samples, uint32_t length) {
+    uint32_t index = 0;
+    
+    while (index < length) {
+        uint16_t wavelength = tia_waveLength[channel];
+        
+        if (wavelength != 0 && tia_waveFilled[channel] == wavelength) {
+            uint16_t position = tia_wavePosition[channel];
+            uint32_t count = wavelength - position;
+            
+            if (count > length - index) {
+                count = length - index;
+            }
+            memcpy(samples + index, tia_wave[channel] + position, count);
+            index += count;
+            position += count;
+            
+            // The poly5 and poly9 counters have moved on by a period's steps
+            if (position == wavelength) {
+                uint16_t steps = TIA_PERIOD[tia_audc[channel]];
+                position = 0;
+                tia_wavePoly5[channel] = (tia_wavePoly5[channel] + steps) % TIA_POLY5_SIZE;
+                if (tia_audc[channel] == 8) {
+                    tia_wavePoly9[channel] = (tia_wavePoly9[channel] + steps) % TIA_POLY9_SIZE;
+                }
+            }
+            tia_wavePosition[channel] = position;
+            continue;
+        }
+        
+        bool stepped = false;
+        if (tia_counter[channel] > 1) {
+            tia_counter[channel]--;
+        }
+        else if (tia_counter[channel] == 1) {
+            tia_counter[channel] = tia_counterMax[channel];
+            stepped = tia_ProcessChannel(channel);
+        }
+        samples[index++] = tia_volume[channel];
+        
+        if (wavelength != 0) {
+            tia_wave[channel][tia_waveFilled[channel]++] = tia_volume[channel];
+            if (tia_waveFilled[channel] == wavelength) {
+                tia_wavePoly5[channel] = tia_poly5Cntr[channel];
+                tia_wavePoly9[channel] = tia_poly9Cntr[channel];
+            }
+        }
+        else if (stepped) {
+            tia_StartWave(channel);
+        }
     }
 }
 
@@ -115,6 +227,7 @@ void tia_Reset(void) {
         tia_poly4Cntr[index] = 0;
         tia_poly5Cntr[index] = 0;
         tia_poly9Cntr[index] = 0;
+        tia_waveLength[index] = 0;
     }
     
     tia_Clear();
@@ -126,38 +239,52 @@ void tia_Clear(void) {
     }
 }
 
+// Audio writes go through Sound.c, which may apply them later on its own
+// thread
 void tia_SetRegister(uint16_t address, uint8_t data) {
+    sound_Write(SOUND_WRITE_TIA, address, data);
+}
+
+// Any change to a channel's registers ends its recorded period
+void tia_Write(uint16_t address, uint8_t data) {
     uint8_t channel;
     uint8_t frequency;
+    uint8_t* reg;
 
     switch (address) {
         case AUDC0:
-            tia_audc[0] = data & 15;
+            reg = &tia_audc[0];
+            data &= 15;
             channel = 0;
             break;
         
         case AUDC1:
-            tia_audc[1] = data & 15;
+            reg = &tia_audc[1];
+            data &= 15;
             channel = 1;
             break;
         
         case AUDF0:
-            tia_audf[0] = data & 31;
+            reg = &tia_audf[0];
+            data &= 31;
             channel = 0;
             break;
         
         case AUDF1:
-            tia_audf[1] = data & 31;
+            reg = &tia_audf[1];
+            data &= 31;
             channel = 1;
             break;
         
         case AUDV0:
-            tia_audv[0] = (data & 15) << 2;
+            reg = &tia_audv[0];
+            data = (data & 15) << 2;
             channel = 0;
             break;
         
         case AUDV1:
-            tia_audv[1] = (data & 15) << 2;
+            reg = &tia_audv[1];
+            data = (data & 15) << 2;
             channel = 1;
             break;
         
@@ -165,6 +292,11 @@ void tia_SetRegister(uint16_t address, uint8_t data) {
             return;
     }
     
+    if (*reg != data) {
+        tia_ClearWave(channel);
+        *reg = data;
+    }
+    
     if (tia_audc[channel] == 0) {
         frequency = 0;
         tia_volume[channel] = tia_audv[channel];
@@ -186,27 +318,24 @@ void tia_SetRegister(uint16_t address, uint8_t data) {
 }
 
 void tia_Process(uint32_t length) {
-    for(size_t index = 0; index < length; index++) {
-        if (tia_counter[0] > 1) {
-            tia_counter[0]--;
-        }
-        else if (tia_counter[0] == 1) {
-            tia_counter[0] = tia_counterMax[0];
-            tia_ProcessChannel(0);
-        }
-        
-        if (tia_counter[1] > 1) {
-            tia_counter[1]--;
-        }
-        else if (tia_counter[1] == 1) {
-            tia_counter[1] = tia_counterMax[1];
-            tia_ProcessChannel(1);
-        }
+    uint8_t samples[2][TIA_CHUNK_SIZE];
+    
+    while (length > 0) {
+        uint32_t count = (length < TIA_CHUNK_SIZE)? length: TIA_CHUNK_SIZE;
         
-        tia_buffer[tia_soundCntr++] = tia_volume[0] + tia_volume[1];
+        tia_ProcessWave(0, samples[0], count);
+        tia_ProcessWave(1, samples[1], count);
         
-        if (tia_soundCntr >= tia_size) {
-            tia_soundCntr = 0;
+        for (uint32_t index = 0; index < count; index++) {
+            uint8_t sample = samples[0][index] + samples[1][index];
+            
+            sound_Level(&sound_tia, tia_soundCntr << 16, sample);
+            tia_buffer[tia_soundCntr++] = sample;
+            
+            if (tia_soundCntr >= tia_size) {
+                tia_soundCntr = 0;
+            }
         }
+        length -= count;
     }
 }
@@ -43,13 +43,46 @@
 #define TIA_H
 #define TIA_BUFFER_SIZE 624
 
+// The longest a channel's output takes to repeat, in samples: the 511 steps
+// of the 9 bit poly at the lowest frequency
+#define TIA_WAVE_SIZE 16352
+
 #include "Equates.h"
 
+typedef struct TiaState {
+    uint8_t buffer[TIA_BUFFER_SIZE];
+    uint32_t size;
+    uint8_t volume[2];
+    uint8_t counterMax[2];
+    uint8_t counter[2];
+    uint8_t audc[2];
+    uint8_t audf[2];
+    uint8_t audv[2];
+    uint32_t poly4Cntr[2];
+    uint32_t poly5Cntr[2];
+    uint32_t poly9Cntr[2];
+    uint32_t soundCntr;
+    // One period of each channel's output, recorded from the step that
+    // starts it, and the counters as they were at that step. waveFilled
+    // counts the samples recorded, and once it reaches waveLength samples
+    // are copied from the period instead of stepped, from wavePosition on.
+    uint8_t wave[2][TIA_WAVE_SIZE];
+    uint16_t waveLength[2];
+    uint16_t waveFilled[2];
+    uint16_t wavePosition[2];
+    uint8_t waveVolume[2];
+    uint8_t wavePoly4[2];
+    uint8_t wavePoly5[2];
+    uint16_t wavePoly9[2];
+} tia_state;
+
 extern void tia_Reset(void);
 extern void tia_SetRegister(uint16_t address, uint8_t data);
+extern void tia_Write(uint16_t address, uint8_t data);
 extern void tia_Clear(void);
 extern void tia_Process(uint32_t length);
-extern uint8_t tia_buffer[TIA_BUFFER_SIZE];
-extern uint32_t tia_size;
+
+#define tia_buffer (prosystem_current->tia.buffer)
+#define tia_size (prosystem_current->tia.size)
 
 #endif
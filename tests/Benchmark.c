@@ -0,0 +1,120 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _      __  ___
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /      / / _
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /   ___/ /__/
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// Benchmark.c
+// ----------------------------------------------------------------------------
+// Runs a fixed program with Maria DMA off for a number of frames, given as
+// the first argument, and reports how many instructions Sally ran per
+// second. The program is one loop of ordinary loads, stores, arithmetic,
+// stack and subroutine instructions with no wait loops, so nearly all the
+// time goes to dispatching instructions. Its outer loop counts itself in
+// RAM, and the instructions run are worked out from that count.
+// BenchmarkSwitch is the same program built with SALLY_THREADED 0.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ProSystem.h"
+#include "TestRom.h"
+
+#define FRAMES 3000
+#define COUNT 0x1800
+#define TABLE 0x1900
+#define POINTER 0x84
+
+// Emits an instruction that runs once per pass of the inner loop
+#define BENCH_OP(...) do { ROM_EMIT(__VA_ARGS__); bench_body++; } while (0)
+
+static uint32_t bench_body;
+
+static uint16_t bench_Build(void) {
+    rom_Begin();
+    
+    uint16_t sub = rom_Here();
+    BENCH_OP(0xb1, POINTER);
+    BENCH_OP(0x09, 0x01);
+    BENCH_OP(0x91, POINTER);
+    BENCH_OP(0x60);
+    
+    uint16_t reset = rom_Here();
+    rom_Start(0x0000, 0x60);
+    ROM_EMIT(0xa9, 0x00, 0x85, POINTER, 0xa9, 0x1a, 0x85, POINTER + 1, 0xa0, 0x00);
+    
+    uint16_t loop = rom_Here();
+    ROM_EMIT(0xa2, 0x00);
+    uint16_t inner = rom_Here();
+    BENCH_OP(0xb9, TABLE & 0xff, TABLE >> 8);
+    BENCH_OP(0x18);
+    BENCH_OP(0x69, 0x13);
+    BENCH_OP(0x99, TABLE & 0xff, TABLE >> 8);
+    BENCH_OP(0xa5, 0x81);
+    BENCH_OP(0x49, 0x5a);
+    BENCH_OP(0x85, 0x81);
+    BENCH_OP(0x0a);
+    BENCH_OP(0x26, 0x82);
+    BENCH_OP(0x24, 0x83);
+    BENCH_OP(0x90, 0x00);
+    BENCH_OP(0x20, sub & 0xff, sub >> 8);
+    BENCH_OP(0x48);
+    BENCH_OP(0x68);
+    BENCH_OP(0x6a);
+    BENCH_OP(0xe6, 0x83);
+    BENCH_OP(0xc8);
+    BENCH_OP(0x98);
+    BENCH_OP(0x29, 0x3f);
+    BENCH_OP(0xa8);
+    BENCH_OP(0xca);
+    BENCH_OP(0xd0, (uint8_t)(inner - (rom_Here() + 2)));
+    
+    // Once per pass of the outer loop, plus two more each time a byte of
+    // the count carries
+    ROM_EMIT(0xee, COUNT & 0xff, COUNT >> 8);
+    rom_Branch(0xd0, loop);
+    ROM_EMIT(0xee, (COUNT + 1) & 0xff, (COUNT + 1) >> 8);
+    rom_Branch(0xd0, loop);
+    ROM_EMIT(0xee, (COUNT + 2) & 0xff, (COUNT + 2) >> 8);
+    ROM_EMIT(0x4c, loop & 0xff, loop >> 8);
+    return reset;
+}
+
+int main(int argc, char** argv) {
+    int frames = argc > 1? atoi(argv[1]): FRAMES;
+    
+    uint16_t reset = bench_Build();
+    if (!rom_Load(reset, reset, reset)) {
+        return 1;
+    }
+    
+    const uint8_t input[17] = {0};
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int frame = 0; frame < frames; frame++) {
+        prosystem_ExecuteFrame(input);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    
+    uint64_t passes = memory_ram[COUNT] | (memory_ram[COUNT + 1] << 8) | (memory_ram[COUNT + 2] << 16);
+    uint64_t instructions = passes * (256 * bench_body + 2) + (passes >> 8) * 2 + (passes >> 16) * 2;
+    double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%d frames in %.3f s: %.0f frames/s, %.1f million instructions/s\n",
+        frames, seconds, frames / seconds, instructions / seconds / 1e6);
+    return 0;
+}
@@ -0,0 +1,435 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _      __  ___
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /      / / _
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /   ___/ /__/
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// FrameHash.c
+// ----------------------------------------------------------------------------
+// Runs a program that keeps changing its display lists, graphics and Maria
+// registers, and checks every frame against a run of the same program with
+// maria_SetRedraw set, which decodes and draws every line from scratch.
+// Both runs go side by side in contexts of their own, with the same output
+// settings, and must end each frame with the same visible lines, cycle
+// count, registers and RAM. The lines each frame changed must fall inside
+// what maria_GetRowDamage reports. The redrawn frames and RAM are also
+// hashed against the output of the renderer from before the decoded zone
+// and the line memo were added.
+//
+// Every so often the program changes a graphics byte, an object's position,
+// graphics in the zero page and stack mirrors at $2090 and $2190, a
+// character number and a palette color. It flips CHARBASE between ROM and
+// RAM, and CTRL between 160A and 320A with two byte characters. While the
+// screen is drawn it moves an object whose display list two zones in a row
+// share, then one on a display list that crosses a page. The stack is left
+// alone, as pushes would change the graphics in its mirror every frame.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ProSystem.h"
+#include "TestRom.h"
+
+#define FRAMES 256
+
+// Hash of the redrawn visible lines and RAM over all frames, as the
+// renderer drew them before it kept anything between lines or frames
+#define FRAME_HASH 0xbe738308a2cf2decULL
+
+// Where the program keeps things in RAM, copied there from IMAGE
+#define DLL 0x1800
+#define DL_A 0x1900
+#define DL_B 0x1920
+#define DL_E 0x1960
+#define GRAPHICS 0x1a00
+#define CHARACTERS 0x1e00
+#define DL_D 0x1ef8
+#define MIRRORED 0x2090
+#define FRAME 0x2400
+#define SHADOW_CHARBASE 0x2402
+#define SHADOW_CTRL 0x2403
+#define DL_C 0x2500
+#define IMAGE 0xe000
+#define IMAGE_PAGES 14
+
+// What stays in ROM
+#define ROM_GRAPHICS 0xc000
+#define ROM_CHARBASE 0xc4
+#define DL_ROM 0xf000
+
+// The character base CHARBASE is flipped to, over GRAPHICS
+#define RAM_CHARBASE 0x1a
+
+// Zones of four lines, and the display list each uses
+#define ZONES 61
+#define ZONE_TYPES "AABCCDRE"
+
+typedef struct {
+    const char* name;
+    bool threaded;
+    bool narrow;
+    bool skip;
+    int format;
+} frame_config;
+
+// A format of -1 draws into maria_surface
+static const frame_config FRAME_CONFIGS[] = {
+    {"surface", false, false, false, -1},
+    {"threaded", true, false, false, -1},
+    {"narrow", false, true, false, -1},
+    {"skip", false, false, true, -1},
+    {"xrgb8888", true, false, false, MARIA_FORMAT_XRGB8888},
+    {"rgb565", false, true, false, MARIA_FORMAT_RGB565},
+    {"indexed8", true, true, false, MARIA_FORMAT_INDEXED8}
+};
+
+typedef struct {
+    prosystem_context* context;
+    uint8_t* buffer;
+    uint32_t pitch;
+    uint32_t pixel;
+    uint32_t start;
+} frame_run;
+
+static uint16_t frame_reset;
+
+static void frame_Put(uint16_t address, const uint8_t* data, uint32_t size) {
+    rom_Put(address - DLL + IMAGE, data, size);
+}
+
+static uint8_t frame_Pattern(uint32_t index) {
+    return (uint8_t)((index * 37) ^ (index >> 3) ^ 0x5a);
+}
+
+// Runs action on frames whose number masked by mask is value
+static void frame_Phase(uint8_t mask, uint8_t value, const uint8_t* action, uint32_t size) {
+    ROM_EMIT(0xad, FRAME & 0xff, FRAME >> 8, 0x29, mask, 0xc9, value);
+    uint16_t skip = rom_Forward(0xd0);
+    rom_Emit(action, size);
+    rom_Land(skip);
+}
+
+#define FRAME_PHASE(mask, value, ...) frame_Phase(mask, value, (const uint8_t[]){__VA_ARGS__}, sizeof((const uint8_t[]){__VA_ARGS__}))
+
+static void frame_Data(void) {
+    // Different graphics in each place, so that reading the wrong one shows
+    static uint8_t graphics[0x1000];
+    for (uint32_t index = 0; index < sizeof(graphics); index++) {
+        graphics[index] = frame_Pattern(index);
+    }
+    rom_Put(ROM_GRAPHICS, graphics, 0x0800);
+    frame_Put(GRAPHICS, graphics + 0x0800, 0x0400);
+    for (int page = 0; page < 4; page++) {
+        frame_Put(MIRRORED + page * 0x100, graphics + 0x0c00 + page * 0x20, 0x20);
+    }
+    
+    // The last one the object reads runs onto the next page with two byte
+    // characters
+    uint8_t characters[16];
+    for (int index = 0; index < 16; index++) {
+        characters[index] = index * 2;
+    }
+    characters[7] = 0xff;
+    frame_Put(CHARACTERS, characters, sizeof(characters));
+    
+    // 160A objects from RAM and ROM
+    const uint8_t a[] = {0x00, 0x38, 0x1a, 20, 0x00, 0x5c, 0xc0, 60, 0, 0};
+    frame_Put(DL_A, a, sizeof(a));
+    // Characters, and graphics in the zero page and stack mirrors
+    const uint8_t b[] = {0x00, 0x60, CHARACTERS >> 8, 0x78, 10, MIRRORED & 0xff, 0x90, MIRRORED >> 8, 90, 0, 0};
+    frame_Put(DL_B, b, sizeof(b));
+    // Write mode on and back off
+    const uint8_t c[] = {0x20, 0xc0, 0x1a, 0xba, 100, 0x10, 0xdc, 0xc0, 130, 0x20, 0x40, 0xc0, 0xfc, 140, 0, 0};
+    frame_Put(DL_C, c, sizeof(c));
+    const uint8_t d[] = {0x40, 0x5c, 0x1a, 5, 0x00, 0x7c, 0xc0, 150, 0x50, 0x3c, 0x1a, 70, 0, 0};
+    frame_Put(DL_D, d, sizeof(d));
+    const uint8_t e[] = {0, 0};
+    frame_Put(DL_E, e, sizeof(e));
+    const uint8_t r[] = {0x30, 0x38, 0xc0, 30, 0, 0};
+    rom_Put(DL_ROM, r, sizeof(r));
+    
+    for (int zone = 0; zone < ZONES; zone++) {
+        uint16_t dl = DL_E;
+        switch (ZONE_TYPES[zone % (sizeof(ZONE_TYPES) - 1)]) {
+            case 'A': dl = DL_A; break;
+            case 'B': dl = DL_B; break;
+            case 'C': dl = DL_C; break;
+            case 'D': dl = DL_D; break;
+            case 'R': dl = DL_ROM; break;
+        }
+        // One zone with holey DMA
+        uint8_t flags = 3;
+        if (zone == 20) {
+            flags |= 0x40;
+        }
+        const uint8_t entry[3] = {flags, dl >> 8, dl & 0xff};
+        frame_Put(DLL + zone * 3, entry, sizeof(entry));
+    }
+}
+
+static void frame_Build(void) {
+    rom_Begin();
+    frame_Data();
+    
+    frame_reset = rom_Here();
+    rom_Start(DLL, 0x60);
+    
+    // Copy the RAM image, then set the colors, skipping the registers
+    // among them
+    ROM_EMIT(0xa2, 0x00);
+    uint16_t copy = rom_Here();
+    for (int page = 0; page < IMAGE_PAGES; page++) {
+        uint16_t from = IMAGE + page * 0x100;
+        uint16_t to = DLL + page * 0x100;
+        ROM_EMIT(0xbd, from & 0xff, from >> 8, 0x9d, to & 0xff, to >> 8);
+    }
+    ROM_EMIT(0xe8);
+    rom_Branch(0xd0, copy);
+    for (uint8_t address = BACKGRND; address <= P7C3; address++) {
+        if ((address & 3) || address == BACKGRND) {
+            ROM_EMIT(0xa9, (uint8_t)(address * 7 + 0x13), 0x85, address);
+        }
+    }
+    ROM_EMIT(0xa9, ROM_CHARBASE, 0x8d, SHADOW_CHARBASE & 0xff, SHADOW_CHARBASE >> 8, 0x85, CHARBASE);
+    ROM_EMIT(0xa9, 0x40, 0x8d, SHADOW_CTRL & 0xff, SHADOW_CTRL >> 8, 0x85, CTRL);
+    
+    uint16_t loop = rom_Here();
+    uint16_t wait = rom_Here();
+    ROM_EMIT(0x24, MSTAT);
+    rom_Branch(0x10, wait);
+    ROM_EMIT(0xee, FRAME & 0xff, FRAME >> 8);
+    
+    // A changed line is only memoized again some frames later, so changes
+    // to the lines of one zone are kept at least sixteen frames apart
+    FRAME_PHASE(0x3f, 0, 0xee, (GRAPHICS + 3) & 0xff, (GRAPHICS + 3) >> 8);
+    FRAME_PHASE(0x3f, 48, 0xee, (DL_A + 3) & 0xff, (DL_A + 3) >> 8);
+    FRAME_PHASE(0x7f, 4, 0xe6, (MIRRORED + 1) & 0xff);
+    FRAME_PHASE(0x7f, 36, 0xee, (MIRRORED + 0x102 - 0x2000) & 0xff, (MIRRORED + 0x102 - 0x2000) >> 8);
+    // Where character $FF's second byte is read from, which only shows
+    // while CHARBASE is in RAM and characters are two bytes
+    FRAME_PHASE(0x7f, 52, 0xee, (RAM_CHARBASE << 8 | 0x100) & 0xff, (RAM_CHARBASE << 8 | 0x100) >> 8);
+    FRAME_PHASE(0x7f, 68, 0xee, (CHARACTERS + 1) & 0xff, (CHARACTERS + 1) >> 8);
+    FRAME_PHASE(0x7f, 100, 0xad, SHADOW_CHARBASE & 0xff, SHADOW_CHARBASE >> 8, 0x49, ROM_CHARBASE ^ RAM_CHARBASE,
+        0x8d, SHADOW_CHARBASE & 0xff, SHADOW_CHARBASE >> 8, 0x85, CHARBASE);
+    FRAME_PHASE(0x3f, 20, 0xad, SHADOW_CTRL & 0xff, SHADOW_CTRL >> 8, 0x49, 0x13,
+        0x8d, SHADOW_CTRL & 0xff, SHADOW_CTRL >> 8, 0x85, CTRL);
+    FRAME_PHASE(0x1f, 10, 0xad, FRAME & 0xff, FRAME >> 8, 0x85, P1C1);
+    
+    // Out of vertical blank, then move DL_C's first object and DL_D's last
+    // one for a while each
+    wait = rom_Here();
+    ROM_EMIT(0x24, MSTAT);
+    rom_Branch(0x30, wait);
+    ROM_EMIT(0xa2, 200);
+    uint16_t move = rom_Here();
+    ROM_EMIT(0xee, (DL_C + 4) & 0xff, (DL_C + 4) >> 8, 0xca);
+    rom_Branch(0xd0, move);
+    ROM_EMIT(0xa2, 200);
+    move = rom_Here();
+    ROM_EMIT(0xee, (DL_D + 11) & 0xff, (DL_D + 11) >> 8, 0xca);
+    rom_Branch(0xd0, move);
+    ROM_EMIT(0x4c, loop & 0xff, loop >> 8);
+}
+
+static uint64_t frame_Hash(uint64_t hash, const uint8_t* data, uint32_t size) {
+    for (uint32_t index = 0; index < size; index++) {
+        hash = (hash ^ data[index]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint16_t frame_Rows(void) {
+    return maria_visibleArea.bottom - maria_visibleArea.top + 1;
+}
+
+static const uint8_t* frame_Row(const frame_run* run, uint16_t row) {
+    if (run->buffer != NULL) {
+        return run->buffer + row * run->pitch;
+    }
+    return maria_surface + (row + maria_visibleArea.top - maria_displayArea.top) * MARIA_LINERAM_SIZE * 2;
+}
+
+static bool frame_Open(frame_run* run, const frame_config* config, bool redraw) {
+    run->context = prosystem_CreateContext();
+    if (run->context == NULL) {
+        return false;
+    }
+    prosystem_SetContext(run->context);
+    if (!rom_Load(frame_reset, frame_reset, frame_reset)) {
+        return false;
+    }
+    
+    run->buffer = NULL;
+    run->pixel = 1;
+    if (config->format >= 0) {
+        run->pixel = (config->format == MARIA_FORMAT_INDEXED8)? 1: (config->format == MARIA_FORMAT_RGB565)? 2: 4;
+        run->pitch = MARIA_LINERAM_SIZE * 2 * run->pixel;
+        run->buffer = calloc(MARIA_SURFACE_HEIGHT, run->pitch);
+        maria_SetOutput(run->buffer, run->pitch, config->format);
+    }
+    maria_SetNarrow(config->narrow);
+    maria_SetRedraw(redraw);
+    if (config->threaded && !redraw) {
+        maria_SetThreaded(true);
+    }
+    run->start = prosystem_clock;
+    return true;
+}
+
+static void frame_Close(frame_run* run) {
+    prosystem_SetContext(run->context);
+    maria_SetThreaded(false);
+    maria_SetOutput(NULL, 0, MARIA_FORMAT_INDEXED8);
+    prosystem_DestroyContext(run->context);
+    prosystem_SetContext(NULL);
+    free(run->buffer);
+}
+
+// What a frame left behind apart from its lines
+typedef struct {
+    uint32_t clock;
+    uint32_t cycles;
+    uint8_t a, x, y, p, s;
+    uint16_t pc;
+    uint64_t ram;
+} frame_state;
+
+static void frame_Run(const frame_run* run, frame_state* state) {
+    const uint8_t input[17] = {0};
+    
+    prosystem_SetContext(run->context);
+    prosystem_ExecuteFrame(input);
+    maria_Flush();
+    state->clock = prosystem_clock - run->start;
+    state->cycles = prosystem_cycles;
+    state->a = sally_a;
+    state->x = sally_x;
+    state->y = sally_y;
+    state->p = sally_GetStatus();
+    state->s = sally_s;
+    state->pc = sally_pc.w;
+    state->ram = frame_Hash(14695981039346656037ULL, memory_ram, MEMORY_SIZE);
+}
+
+static bool frame_Same(const frame_state* a, const frame_state* b) {
+    return a->clock == b->clock && a->cycles == b->cycles && a->a == b->a && a->x == b->x && a->y == b->y &&
+        a->p == b->p && a->s == b->s && a->pc == b->pc && a->ram == b->ram;
+}
+
+// Checks the test run's lines against the redrawn ones, and that every
+// column that changed since last is inside the damage the test run reports.
+// Leaves the redrawn lines in last.
+static uint32_t frame_CheckLines(const frame_config* config, int frame, const frame_run* test, const frame_run* redrawn, uint8_t* last, uint16_t* lastWidth) {
+    uint32_t failures = 0;
+    uint32_t size = MARIA_LINERAM_SIZE * 2 * redrawn->pixel;
+    
+    for (uint16_t row = 0; row < frame_Rows(); row++) {
+        prosystem_SetContext(redrawn->context);
+        uint16_t width = maria_GetLineWidth(row);
+        const uint8_t* line = frame_Row(redrawn, row);
+        uint8_t copy[MARIA_LINERAM_SIZE * 2 * 4];
+        memcpy(copy, line, width * redrawn->pixel);
+        
+        prosystem_SetContext(test->context);
+        uint16_t left;
+        uint16_t right;
+        bool damaged = maria_GetRowDamage(row, &left, &right);
+        if (maria_GetLineWidth(row) != width || memcmp(frame_Row(test, row), copy, width * redrawn->pixel)) {
+            if (failures++ == 0) {
+                printf("%s: frame %d: line %d differs\n", config->name, frame, row);
+            }
+        }
+        
+        uint8_t* previous = last + row * size;
+        for (uint16_t column = 0; column < width; column++) {
+            bool changed = frame > 0 && (lastWidth[row] != width ||
+                memcmp(previous + column * redrawn->pixel, copy + column * redrawn->pixel, redrawn->pixel));
+            if (changed && (!damaged || column < left || column > right)) {
+                if (failures++ == 0) {
+                    printf("%s: frame %d: line %d column %d changed outside the damage\n", config->name, frame, row, column);
+                }
+                break;
+            }
+        }
+        memcpy(previous, copy, width * redrawn->pixel);
+        lastWidth[row] = width;
+    }
+    return failures;
+}
+
+static uint32_t frame_Check(const frame_config* config, uint64_t* hash) {
+    static uint8_t last[MARIA_SURFACE_HEIGHT * MARIA_LINERAM_SIZE * 2 * 4];
+    static uint16_t lastWidth[MARIA_SURFACE_HEIGHT];
+    frame_run test;
+    frame_run redrawn;
+    uint32_t failures = 0;
+    
+    if (!frame_Open(&test, config, false) || !frame_Open(&redrawn, config, true)) {
+        return 1;
+    }
+    
+    for (int frame = 0; frame < FRAMES && !failures; frame++) {
+        frame_state expected;
+        frame_state state;
+        bool skip = config->skip && frame % 3 != 2;
+        
+        frame_Run(&redrawn, &expected);
+        prosystem_SetContext(test.context);
+        maria_SetSkip(skip);
+        frame_Run(&test, &state);
+        
+        if (!frame_Same(&state, &expected)) {
+            printf("%s: frame %d: clock %u/%u cycles %u/%u PC %04x/%04x RAM %s\n", config->name, frame,
+                state.clock, expected.clock, state.cycles, expected.cycles, state.pc, expected.pc,
+                state.ram == expected.ram? "same": "differs");
+            failures++;
+        }
+        if (!skip) {
+            failures += frame_CheckLines(config, frame, &test, &redrawn, last, lastWidth);
+        }
+        
+        if (hash != NULL) {
+            prosystem_SetContext(redrawn.context);
+            for (uint16_t row = 0; row < frame_Rows(); row++) {
+                *hash = frame_Hash(*hash, frame_Row(&redrawn, row), MARIA_LINERAM_SIZE * 2);
+            }
+            *hash = frame_Hash(*hash, memory_ram, MEMORY_SIZE);
+        }
+    }
+    
+    frame_Close(&test);
+    frame_Close(&redrawn);
+    return failures;
+}
+
+int main(void) {
+    uint32_t failures = 0;
+    uint64_t hash = 14695981039346656037ULL;
+    
+    frame_Build();
+    for (int index = 0; index < (int)(sizeof(FRAME_CONFIGS) / sizeof(FRAME_CONFIGS[0])); index++) {
+        failures += frame_Check(&FRAME_CONFIGS[index], index == 0? &hash: NULL);
+    }
+    if (hash != FRAME_HASH) {
+        printf("hash %016llx, expected %016llx\n", (unsigned long long)hash, (unsigned long long)FRAME_HASH);
+        failures++;
+    }
+    
+    printf("%s: %u configurations, %u failures\n", failures? "FAIL": "ok", (uint32_t)(sizeof(FRAME_CONFIGS) / sizeof(FRAME_CONFIGS[0])), failures);
+    return failures? 1: 0;
+}
@@ -0,0 +1,1531 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _      __  ___
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /      / / _
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /   ___/ /__/
+//
+// ----------------------------------------------------------------------------
+// Copyright 2005 Greg Stanton
+// Copyright 2020 Rupert Carmichael
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// ----------------------------------------------------------------------------
+// SallyEager.c
+// ----------------------------------------------------------------------------
+// The 6502 core as it was while every instruction still set N and Z in the
+// status byte itself, kept as the reference SallyFlags.c checks the lazy
+// flags against. It runs on a flat 64K array of its own.
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "SallyEager.h"
+
+uint8_t eager_a = 0;
+uint8_t eager_x = 0;
+uint8_t eager_y = 0;
+uint8_t eager_p = 0;
+uint8_t eager_s = 0;
+pair eager_pc = {0};
+
+static uint8_t eager_opcode;
+static pair eager_address;
+static uint32_t eager_cycles;
+
+uint8_t eager_memory[65536];
+
+static inline uint8_t eager_Read(uint16_t address) {
+    return eager_memory[address];
+}
+
+static inline void eager_Write(uint16_t address, uint8_t data) {
+    eager_memory[address] = data;
+}
+
+typedef struct Flag {
+    uint8_t C;
+    uint8_t Z;
+    uint8_t I;
+    uint8_t D;
+    uint8_t B;
+    uint8_t R;
+    uint8_t V;
+    uint8_t N;
+} Flag;
+
+static const Flag EAGER_FLAG = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+
+typedef struct Vector {
+  uint16_t H;
+  uint16_t L;
+} Vector;
+
+static const Vector EAGER_RES = {65533, 65532};
+static const Vector EAGER_NMI = {65531, 65530};
+static const Vector EAGER_IRQ = {65535, 65534};
+
+static const uint8_t EAGER_CYCLES[256] = {
+    7,6,0,0,0,3,5,0,3,2,2,2,0,4,6,0,
+    2,5,0,0,0,4,6,0,2,4,0,0,0,4,7,0,
+    6,6,0,0,3,3,5,0,4,2,2,2,4,4,6,0,
+    2,5,0,0,0,4,6,0,2,4,0,0,0,4,7,0,
+    6,6,0,0,0,3,5,0,3,2,2,2,3,4,6,0,
+    2,5,0,0,0,4,6,0,2,4,0,0,0,4,7,0,
+    6,6,0,0,0,3,5,0,4,2,2,0,5,4,6,0,
+    2,5,0,0,0,4,6,0,2,4,0,0,0,4,7,0,
+    0,6,0,0,3,3,3,0,2,0,2,0,4,4,4,0,
+    2,6,0,0,4,4,4,0,2,5,2,0,0,5,0,0,
+    2,6,2,0,3,3,3,0,2,2,2,0,4,4,4,0,
+    2,5,0,0,4,4,4,0,2,4,2,0,4,4,4,0,
+    2,6,0,0,3,3,5,0,2,2,2,0,4,4,6,0,
+    2,5,0,0,0,4,6,0,2,4,0,0,0,4,7,0,
+    2,6,0,0,3,3,5,0,2,2,2,0,4,4,6,0,
+    2,5,0,0,0,4,6,0,2,4,0,0,0,4,7,0,
+};
+
+static void eager_Push(uint8_t data) {
+    eager_Write(eager_s + 256, data);
+    eager_s--;
+}
+
+static uint8_t eager_Pop(void) {
+    eager_s++;
+    return eager_Read(eager_s + 256);
+}
+
+static void eager_Flags(uint8_t data) {
+    if (!data) {
+        eager_p |= EAGER_FLAG.Z;
+    }
+    else {
+        eager_p &= ~EAGER_FLAG.Z;
+    }
+    
+    if (data & 128) {
+        eager_p |= EAGER_FLAG.N;
+    }
+    else {
+        eager_p &= ~EAGER_FLAG.N;
+    }
+}
+
+static void eager_Branch(uint8_t branch) {
+    if (branch) {
+        pair temp = eager_pc;
+        eager_pc.w += (signed char)eager_address.b.l;
+        
+        if (temp.b.h != eager_pc.b.h) {
+            eager_cycles += 2;
+        }
+        else {
+            eager_cycles++;
+        }
+    }
+}
+
+static void eager_Delay(uint8_t delta) {
+    pair address1 = eager_address;
+    pair address2 = eager_address;
+    address1.w -= delta;
+    
+    if (address1.b.h != address2.b.h) {
+        eager_cycles++;
+    }
+}
+
+static void eager_Absolute(void) {
+    eager_address.b.l = eager_Read(eager_pc.w++);
+    eager_address.b.h = eager_Read(eager_pc.w++);
+}
+
+static void eager_AbsoluteX(void) {
+    eager_address.b.l = eager_Read(eager_pc.w++);
+    eager_address.b.h = eager_Read(eager_pc.w++);
+    eager_address.w += eager_x;
+}
+
+static void eager_AbsoluteY(void) {
+    eager_address.b.l = eager_Read(eager_pc.w++);
+    eager_address.b.h = eager_Read(eager_pc.w++);
+    eager_address.w += eager_y;
+}
+
+static void eager_Immediate(void) {
+    eager_address.w = eager_pc.w++;
+}
+
+static void eager_Indirect(void) {
+    pair base;
+    base.b.l = eager_Read(eager_pc.w++);
+    base.b.h = eager_Read(eager_pc.w++);
+    eager_address.b.l = eager_Read(base.w);
+    eager_address.b.h = eager_Read(base.w + 1);
+}
+
+static void eager_IndirectX(void) {
+    eager_address.b.l = eager_Read(eager_pc.w++) + eager_x;
+    eager_address.b.h = eager_Read(eager_address.b.l + 1);
+    eager_address.b.l = eager_Read(eager_address.b.l);
+}
+
+static void eager_IndirectY(void) {
+    eager_address.b.l = eager_Read(eager_pc.w++);
+    eager_address.b.h = eager_Read(eager_address.b.l + 1);
+    eager_address.b.l = eager_Read(eager_address.b.l);
+    eager_address.w += eager_y;
+}
+
+static void eager_Relative(void) {
+    eager_address.w = eager_Read(eager_pc.w++);
+}
+
+static void eager_ZeroPage(void) {
+    eager_address.w = eager_Read(eager_pc.w++);
+}
+
+static void eager_ZeroPageX(void) {
+    eager_address.w = eager_Read(eager_pc.w++);
+    eager_address.b.l += eager_x;
+}
+
+static void eager_ZeroPageY(void) {
+    eager_address.w = eager_Read(eager_pc.w++);
+    eager_address.b.l += eager_y;
+}
+
+static void eager_ADC(void) {
+    uint8_t data = eager_Read(eager_address.w);
+    
+    if (eager_p & EAGER_FLAG.D) {
+        uint16_t al = (eager_a & 15) + (data & 15) + (eager_p & EAGER_FLAG.C);
+        uint16_t ah = (eager_a >> 4) + (data >> 4);
+        
+        if (al > 9) {
+            al += 6;
+            ah++;
+        }
+        
+        if (!(eager_a + data + (eager_p & EAGER_FLAG.C))) {
+            eager_p |= EAGER_FLAG.Z;
+        }
+        else {
+            eager_p &= ~EAGER_FLAG.Z;
+        }
+        
+        if ((ah & 8) != 0) {
+            eager_p |= EAGER_FLAG.N;
+        }
+        else {
+            eager_p &= ~EAGER_FLAG.N;
+        }
+        
+        if (~(eager_a ^ data) & ((ah << 4) ^ eager_a) & 128) {
+            eager_p |= EAGER_FLAG.V;
+        }
+        else {
+            eager_p &= ~EAGER_FLAG.V;
+        }
+        
+        if (ah > 9) {
+            ah += 6;
+        }
+        
+        if (ah > 15) {
+            eager_p |= EAGER_FLAG.C;
+        }
+        else {
+            eager_p &= ~EAGER_FLAG.C;
+        }
+        
+        eager_a = (ah << 4) | (al & 15);
+    }
+    else {
+        pair temp;
+        temp.w = eager_a + data + (eager_p & EAGER_FLAG.C);
+        
+        if (temp.b.h) {
+            eager_p |= EAGER_FLAG.C;
+        }
+        else {
+            eager_p &= ~EAGER_FLAG.C;
+        }
+        
+        if (~(eager_a ^ data) & (eager_a ^ temp.b.l) & 128) {
+            eager_p |= EAGER_FLAG.V;
+        }
+        else {
+            eager_p &= ~EAGER_FLAG.V;
+        }
+        
+        eager_Flags(temp.b.l);
+        eager_a = temp.b.l;
+    }
+}
+
+static void eager_AND(void) {
+    eager_a &= eager_Read(eager_address.w);
+    eager_Flags(eager_a);
+}
+
+static void eager_ASLA(void) {
+    if(eager_a & 128) {
+        eager_p |= EAGER_FLAG.C;
+    }
+    else {
+        eager_p &= ~EAGER_FLAG.C;
+    }
+    
+    eager_a <<= 1;
+    eager_Flags(eager_a);
+}
+
+static void eager_ASL(void) {
+    uint8_t data = eager_Read(eager_address.w);
+    
+    if (data & 128) {
+        eager_p |= EAGER_FLAG.C;
+    }
+    else {
+        eager_p &= ~EAGER_FLAG.C;
+    }
+    
+    data <<= 1;
+    eager_Write(eager_address.w, data);
+    eager_Flags(data);
+}
+
+static void eager_BCC(void) {
+    eager_Branch(!(eager_p & EAGER_FLAG.C));
+}
+
+static void eager_BCS(void) {
+    eager_Branch(eager_p & EAGER_FLAG.C);
+}
+
+static void eager_BEQ(void) {
+    eager_Branch(eager_p & EAGER_FLAG.Z);
+}
+
+static void eager_BIT(void) {
+    uint8_t data = eager_Read(eager_address.w);
+    
+    if (!(data & eager_a)) {
+        eager_p |= EAGER_FLAG.Z;
+    }
+    else {
+        eager_p &= ~EAGER_FLAG.Z;
+    }
+    
+    eager_p &= ~EAGER_FLAG.V;
+    eager_p &= ~EAGER_FLAG.N;
+    eager_p |= data & 64;
+    eager_p |= data & 128;
+}
+
+static void eager_BMI(void) {
+    eager_Branch(eager_p & EAGER_FLAG.N);
+}
+
+static void eager_BNE(void) {
+    eager_Branch(!(eager_p & EAGER_FLAG.Z));
+}
+
+static void eager_BPL(void) {
+    eager_Branch(!(eager_p & EAGER_FLAG.N));
+}
+
+static void eager_BRK(void) {
+    eager_pc.w++;
+    eager_p |= EAGER_FLAG.B;
+    
+    eager_Push(eager_pc.b.h);
+    eager_Push(eager_pc.b.l);
+    eager_Push(eager_p);
+    
+    eager_p |= EAGER_FLAG.I;
+    eager_pc.b.l = eager_memory[EAGER_IRQ.L];
+    eager_pc.b.h = eager_memory[EAGER_IRQ.H];
+}
+
+static void eager_BVC(void) {
+    eager_Branch(!(eager_p & EAGER_FLAG.V));
+}
+
+static void eager_BVS(void) {
+    eager_Branch(eager_p & EAGER_FLAG.V);
+}
+
+static void eager_CLC(void) {
+    eager_p &= ~EAGER_FLAG.C;
+}
+
+static void eager_CLD(void) {
+    eager_p &= ~EAGER_FLAG.D;
+}
+
+static void eager_CLI(void) {
+    eager_p &= ~EAGER_FLAG.I;
+}
+
+static void eager_CLV(void) {
+    eager_p &= ~EAGER_FLAG.V;
+}
+
+static void eager_CMP(void) {
+    uint8_t data = eager_Read(eager_address.w);
+    
+    if (eager_a >= data) {
+        eager_p |= EAGER_FLAG.C;
+    }
+    else {
+        eager_p &= ~EAGER_FLAG.C;
+    }
+    
+    eager_Flags(eager_a - data);
+}
+
+static void eager_CPX(void) {
+    uint8_t data = eager_Read(eager_address.w);
+    
+    if (eager_x >= data) {
+        eager_p |= EAGER_FLAG.C;
+    }
+    else {
+        eager_p &= ~EAGER_FLAG.C;
+    }
+    
+    eager_Flags(eager_x - data);
+}
+
+static void eager_CPY(void) {
+    uint8_t data = eager_Read(eager_address.w);
+    
+    if (eager_y >= data) {
+        eager_p |= EAGER_FLAG.C;
+    }
+    else {
+        eager_p &= ~EAGER_FLAG.C;
+    }
+    
+    eager_Flags(eager_y - data);
+}
+
+static void eager_DEC(void) {
+    uint8_t data = eager_Read(eager_address.w);
+    eager_Write(eager_address.w, --data);
+    eager_Flags(data);
+}
+
+static void eager_DEX(void) {
+    eager_Flags(--eager_x);
+}
+
+static void eager_DEY(void) {
+    eager_Flags(--eager_y);
+}
+
+static void eager_EOR(void) {
+    eager_a ^= eager_Read(eager_address.w);
+    eager_Flags(eager_a);
+}
+
+static void eager_INC(void) {
+    uint8_t data = eager_Read(eager_address.w);
+    eager_Write(eager_address.w, ++data);
+    eager_Flags(data);
+}
+
+static void eager_INX(void) {
+    eager_Flags(++eager_x);
+}
+
+static void eager_INY(void) {
+    eager_Flags(++eager_y);
+}
+
+static void eager_JMP(void) {
+    eager_pc = eager_address;
+}
+
+static void eager_JSR(void) {
+    eager_pc.w--;
+    eager_Push(eager_pc.b.h);
+    eager_Push(eager_pc.b.l);
+    
+    eager_pc = eager_address;
+}
+
+static void eager_LDA(void) {
+    eager_a = eager_Read(eager_address.w);
+    eager_Flags(eager_a);
+}
+
+static void eager_LDX(void) {
+    eager_x = eager_Read(eager_address.w);
+    eager_Flags(eager_x);
+}
+
+static void eager_LDY(void) {
+    eager_y = eager_Read(eager_address.w);
+    eager_Flags(eager_y);
+}
+
+static void eager_LSRA(void) {
+    eager_p &= ~EAGER_FLAG.C;
+    eager_p |= eager_a & 1;
+    
+    eager_a >>= 1;
+    eager_Flags(eager_a);
+}
+
+static void eager_LSR(void) {
+    uint8_t data = eager_Read(eager_address.w);
+    
+    eager_p &= ~EAGER_FLAG.C;
+    eager_p |= data & 1;
+    
+    data >>= 1;
+    eager_Write(eager_address.w, data);
+    eager_Flags(data);
+}
+
+static void eager_NOP(void) {
+}
+
+static void eager_ORA(void) {
+    eager_a |= eager_Read(eager_address.w);
+    eager_Flags(eager_a);
+}
+
+static void eager_PHA(void) {
+    eager_Push(eager_a);
+}
+
+static void eager_PHP(void) {
+    eager_Push(eager_p);
+}
+
+static void eager_PLA(void) {
+    eager_a = eager_Pop();
+    eager_Flags(eager_a);
+}
+
+static void eager_PLP(void) {
+    eager_p = eager_Pop();
+}
+
+static void eager_ROLA(void) {
+    uint8_t temp = eager_p;
+    
+    if (eager_a & 128) {
+        eager_p |= EAGER_FLAG.C;
+    }
+    else {
+        eager_p &= ~EAGER_FLAG.C;
+    }
+    
+    eager_a <<= 1;
+    eager_a |= temp & EAGER_FLAG.C;
+    eager_Flags(eager_a);
+}
+
+static void eager_ROL(void) {
+    uint8_t data = eager_Read(eager_address.w);
+    uint8_t temp = eager_p;
+    
+    if (data & 128) {
+        eager_p |= EAGER_FLAG.C;
+    }
+    else {
+        eager_p &= ~EAGER_FLAG.C;
+    }
+    
+    data <<= 1;
+    data |= temp & 1;
+    eager_Write(eager_address.w, data);
+    eager_Flags(data);
+}
+
+static void eager_RORA(void) {
+    uint8_t temp = eager_p;
+    
+    eager_p &= ~EAGER_FLAG.C;
+    eager_p |= eager_a & 1;
+    
+    eager_a >>= 1;
+    if(temp & EAGER_FLAG.C) {
+        eager_a |= 128;
+    }
+    
+    eager_Flags(eager_a);
+}
+
+static void eager_ROR(void) {
+    uint8_t data = eager_Read(eager_address.w);
+    uint8_t temp = eager_p;
+    
+    eager_p &= ~EAGER_FLAG.C;
+    eager_p |= data & 1;
+    
+    data >>= 1;
+    if(temp & 1) {
+        data |= 128;
+    }
+    
+    eager_Write(eager_address.w, data);
+    eager_Flags(data);
+}
+
+static void eager_RTI(void) {
+    eager_p = eager_Pop();
+    eager_pc.b.l = eager_Pop();
+    eager_pc.b.h = eager_Pop();
+}
+
+static void eager_RTS(void) {
+    eager_pc.b.l = eager_Pop();
+    eager_pc.b.h = eager_Pop();
+    eager_pc.w++;
+}
+
+static void eager_SBC(void) {
+    uint8_t data = eager_Read(eager_address.w);
+    
+    if (eager_p & EAGER_FLAG.D) {
+        uint16_t al = (eager_a & 15) - (data & 15) - !(eager_p & EAGER_FLAG.C);
+        uint16_t ah = (eager_a >> 4) - (data >> 4);
+        
+        if(al > 9) {
+            al -= 6;
+            ah--;
+        }
+        
+        if(ah > 9) {
+            ah -= 6;
+        }
+        
+        pair temp;
+        temp.w = eager_a - data - !(eager_p & EAGER_FLAG.C);
+        
+        if (!temp.b.h) {
+            eager_p |= EAGER_FLAG.C;
+        }
+        else {
+            eager_p &= ~EAGER_FLAG.C;
+        }
+        
+        if ((eager_a ^ data) & (eager_a ^ temp.b.l) & 128) {
+            eager_p |= EAGER_FLAG.V;
+        }
+        else {
+            eager_p &= ~EAGER_FLAG.V;
+        }
+        
+        eager_Flags(temp.b.l);
+        eager_a = (ah << 4) | (al & 15);
+    }
+    else {
+        pair temp;
+        temp.w = eager_a - data - !(eager_p & EAGER_FLAG.C);
+        
+        if (!temp.b.h) {
+            eager_p |= EAGER_FLAG.C;
+        }
+        else {
+            eager_p &= ~EAGER_FLAG.C;
+        }
+        
+        if ((eager_a ^ data) & (eager_a ^ temp.b.l) & 128) {
+            eager_p |= EAGER_FLAG.V;
+        }
+        else {
+            eager_p &= ~EAGER_FLAG.V;
+        }
+        
+        eager_Flags(temp.b.l);
+        eager_a = temp.b.l;
+    }
+}
+
+static void eager_SEC(void) {
+    eager_p |= EAGER_FLAG.C;
+}
+
+static void eager_SED(void) {
+    eager_p |= EAGER_FLAG.D;
+}
+
+static void eager_SEI(void) {
+    eager_p |= EAGER_FLAG.I;
+}
+
+static void eager_STA(void) {
+    eager_Write(eager_address.w, eager_a);
+}
+
+static void eager_stx(void) {
+    eager_Write(eager_address.w, eager_x);
+}
+
+static void eager_STY(void) {
+    eager_Write(eager_address.w, eager_y);
+}
+
+static void eager_TAX(void) {
+    eager_x = eager_a;
+    eager_Flags(eager_x);
+}
+
+static void eager_TAY(void) {
+    eager_y = eager_a;
+    eager_Flags(eager_y);
+}
+
+static void eager_TSX(void) {
+    eager_x = eager_s;
+    eager_Flags(eager_x);
+}
+
+static void eager_TXA(void) {
+    eager_a = eager_x;
+    eager_Flags(eager_a);
+}
+
+static void eager_TXS(void) {
+    eager_s = eager_x;
+}
+
+static void eager_TYA(void) {
+    eager_a = eager_y;
+    eager_Flags(eager_a);
+}
+
+void eager_Reset(void) {
+    eager_a = 0;
+    eager_x = 0;
+    eager_y = 0;
+    eager_p = EAGER_FLAG.R;
+    eager_s = 0;
+    eager_pc.w = 0;
+}
+
+uint32_t eager_ExecuteInstruction(void) {
+    eager_opcode = eager_Read(eager_pc.w++);
+    eager_cycles = EAGER_CYCLES[eager_opcode];
+
+    switch (eager_opcode) {
+        case 0x00:
+            eager_BRK();
+            break;
+        
+        case 0x01:
+            eager_IndirectX();
+            eager_ORA();
+            break;
+        
+        case 0x05:
+            eager_ZeroPage();
+            eager_ORA();
+            break;
+        
+        case 0x06:
+            eager_ZeroPage();
+            eager_ASL();
+            break;
+        
+        case 0x08:
+            eager_PHP();
+            break;
+        
+        case 0x09:
+            eager_Immediate();
+            eager_ORA();
+            break;
+        
+        case 0x0a:
+            eager_ASLA();
+            break;
+        
+        case 0x0b: // ANC
+        case 0x2b: { // ANC
+            eager_Immediate();
+            eager_AND();
+            if (eager_a & 128) {
+                eager_p |= EAGER_FLAG.C;
+            }
+            else {
+                //eager_p &= ~EAGER_FLAG.C;
+                eager_p = (eager_p & ~EAGER_FLAG.C) & 0xFF;
+            }
+            break;
+        }
+        case 0x0d:
+            eager_Absolute();
+            eager_ORA();
+            break;
+        
+        case 0x0e:
+            eager_Absolute();
+            eager_ASL();
+            break;
+        
+        case 0x10:
+            eager_Relative();
+            eager_BPL();
+            break;
+        
+        case 0x11:
+            eager_IndirectY();
+            eager_ORA();
+            eager_Delay(eager_y);
+            break;
+        
+        case 0x15:
+            eager_ZeroPageX();
+            eager_ORA();
+            break;
+        
+        case 0x16:
+            eager_ZeroPageX();
+            eager_ASL();
+            break;
+        
+        case 0x18:
+            eager_CLC();
+            break;
+        
+        case 0x19:
+            eager_AbsoluteY();
+            eager_ORA();
+            eager_Delay(eager_y);
+            break;
+        
+        case 0x1d:
+            eager_AbsoluteX();
+            eager_ORA();
+            eager_Delay(eager_x);
+            break;
+        
+        case 0x1e:
+            eager_AbsoluteX();
+            eager_ASL();
+            break;
+        
+        case 0x20:
+            eager_Absolute();
+            eager_JSR();
+            break;
+        
+        case 0x21:
+            eager_IndirectX();
+            eager_AND();
+            break;
+        
+        case 0x24:
+            eager_ZeroPage();
+            eager_BIT();
+            break;
+        
+        case 0x25:
+            eager_ZeroPage();
+            eager_AND();
+            break;
+        
+        case 0x26:
+            eager_ZeroPage();
+            eager_ROL();
+            break;
+        
+        case 0x28:
+            eager_PLP();
+            break;
+        
+        case 0x29:
+            eager_Immediate();
+            eager_AND();
+            break;
+        
+        case 0x2a:
+            eager_ROLA();
+            break;
+        
+        case 0x2c:
+            eager_Absolute();
+            eager_BIT();
+            break;
+        
+        case 0x2d:
+            eager_Absolute();
+            eager_AND();
+            break;
+        
+        case 0x2e:
+            eager_Absolute();
+            eager_ROL();
+            break;
+        
+        case 0x30:
+            eager_Relative();
+            eager_BMI();
+            break;
+        
+        case 0x31:
+            eager_IndirectY();
+            eager_AND();
+            eager_Delay(eager_y);
+            break;
+        
+        case 0x35:
+            eager_ZeroPageX();
+            eager_AND();
+            break;
+        
+        case 0x36:
+            eager_ZeroPageX();
+            eager_ROL();
+            break;
+        
+        case 0x38:
+            eager_SEC();
+            break;
+        
+        case 0x39:
+            eager_AbsoluteY();
+            eager_AND();
+            eager_Delay(eager_y);
+            break;
+        
+        case 0x3d:
+            eager_AbsoluteX();
+            eager_AND();
+            eager_Delay(eager_x);
+            break;
+        
+        case 0x3e:
+            eager_AbsoluteX();
+            eager_ROL();
+            break;
+        
+        case 0x40:
+            eager_RTI();
+            break;
+        
+        case 0x41:
+            eager_IndirectX();
+            eager_EOR();
+            break;
+        
+        case 0x45:
+            eager_ZeroPage();
+            eager_EOR();
+            break;
+        
+        case 0x46:
+            eager_ZeroPage();
+            eager_LSR();
+            break;
+        
+        case 0x48:
+            eager_PHA();
+            break;
+        
+        case 0x49:
+            eager_Immediate();
+            eager_EOR();
+            break;
+        
+        case 0x4a:
+            eager_LSRA();
+            break;
+        
+        case 0x4b: // ALR (ASR)
+            eager_Immediate();
+            eager_AND();
+            eager_LSRA();
+            break;
+        
+        case 0x4c:
+            eager_Absolute();
+            eager_JMP();
+            break;
+        
+        case 0x4d:
+            eager_Absolute();
+            eager_EOR();
+            break;
+        
+        case 0x4e:
+            eager_Absolute();
+            eager_LSR();
+            break;
+        
+        case 0x50:
+            eager_Relative();
+            eager_BVC();
+            break;
+        
+        case 0x51:
+            eager_IndirectY();
+            eager_EOR();
+            eager_Delay(eager_y);
+            break;
+        
+        case 0x55:
+            eager_ZeroPageX();
+            eager_EOR();
+            break;
+        
+        case 0x56:
+            eager_ZeroPageX();
+            eager_LSR();
+            break;
+        
+        case 0x58:
+            eager_CLI();
+            break;
+        
+        case 0x59:
+            eager_AbsoluteY();
+            eager_EOR();
+            eager_Delay(eager_y);
+            break;
+        
+        case 0x5d:
+            eager_AbsoluteX();
+            eager_EOR();
+            eager_Delay(eager_x);
+            break;
+        
+        case 0x5e:
+            eager_AbsoluteX();
+            eager_LSR();
+            break;
+        
+        case 0x60:
+            eager_RTS();
+            break;
+        
+        case 0x61:
+            eager_IndirectX();
+            eager_ADC();
+            break;
+        
+        case 0x65:
+            eager_ZeroPage();
+            eager_ADC();
+            break;
+        
+        case 0x66:
+            eager_ZeroPage();
+            eager_ROR();
+            break;
+        
+        case 0x68:
+            eager_PLA();
+            break;
+        
+        case 0x69:
+            eager_Immediate();
+            eager_ADC();
+            break;
+        
+        case 0x6a:
+            eager_RORA();
+            break;
+        
+        case 0x6c:
+            eager_Indirect();
+            eager_JMP();
+            break;
+        
+        case 0x6d:
+            eager_Absolute();
+            eager_ADC();
+            break;
+        
+        case 0x6e:
+            eager_Absolute();
+            eager_ROR();
+            break;
+        
+        case 0x70:
+            eager_Relative();
+            eager_BVS();
+            break;
+        
+        case 0x71:
+            eager_IndirectY();
+            eager_ADC();
+            eager_Delay(eager_y);
+            break;
+        
+        case 0x75:
+            eager_ZeroPageX();
+            eager_ADC();
+            break;
+        
+        case 0x76:
+            eager_ZeroPageX();
+            eager_ROR();
+            break;
+        
+        case 0x78:
+            eager_SEI();
+            break;
+        
+        case 0x79:
+            eager_AbsoluteY();
+            eager_ADC();
+            eager_Delay(eager_y);
+            break;
+        
+        case 0x7d:
+            eager_AbsoluteX();
+            eager_ADC();
+            eager_Delay(eager_x);
+            break;
+        
+        case 0x7e:
+            eager_AbsoluteX();
+            eager_ROR();
+            break;
+        
+        case 0x81:
+            eager_IndirectX();
+            eager_STA();
+            break;
+        
+        case 0x84:
+            eager_ZeroPage();
+            eager_STY();
+            break;
+        
+        case 0x85:
+            eager_ZeroPage();
+            eager_STA();
+            break;
+        
+        case 0x86:
+            eager_ZeroPage();
+            eager_stx();
+            break;
+        
+        case 0x88:
+            eager_DEY();
+            break;
+        
+        case 0x8a:
+            eager_TXA();
+            break;
+        
+        case 0x8c:
+            eager_Absolute();
+            eager_STY();
+            break;
+        
+        case 0x8d:
+            eager_Absolute();
+            eager_STA();
+            break;
+        
+        case 0x8e:
+            eager_Absolute();
+            eager_stx();
+            break;
+        
+        case 0x90:
+            eager_Relative();
+            eager_BCC();
+            break;
+        
+        case 0x91:
+            eager_IndirectY();
+            eager_STA();
+            break;
+        
+        case 0x94:
+            eager_ZeroPageX();
+            eager_STY();
+            break;
+        
+        case 0x95:
+            eager_ZeroPageX();
+            eager_STA();
+            break;
+        
+        case 0x96:
+            eager_ZeroPageY();
+            eager_stx();
+            break;
+        
+        case 0x98:
+            eager_TYA();
+            break;
+        
+        case 0x99:
+            eager_AbsoluteY();
+            eager_STA();
+            break;
+        
+        case 0x9a:
+            eager_TXS();
+            break;
+        
+        case 0x9d:
+            eager_AbsoluteX();
+            eager_STA();
+            break;
+        
+        case 0xa0:
+            eager_Immediate();
+            eager_LDY();
+            break;
+        
+        case 0xa1:
+            eager_IndirectX();
+            eager_LDA();
+            break;
+        
+        case 0xa2:
+            eager_Immediate();
+            eager_LDX();
+            break;
+        
+        case 0xa4:
+            eager_ZeroPage();
+            eager_LDY();
+            break;
+        
+        case 0xa5:
+            eager_ZeroPage();
+            eager_LDA();
+            break;
+        
+        case 0xa6:
+            eager_ZeroPage();
+            eager_LDX();
+            break;
+        
+        case 0xa8:
+            eager_TAY();
+            break;
+        
+        case 0xa9:
+            eager_Immediate();
+            eager_LDA();
+            break;
+        
+        case 0xaa:
+            eager_TAX();
+            break;
+        
+        case 0xac:
+            eager_Absolute();
+            eager_LDY();
+            break;
+        
+        case 0xad:
+            eager_Absolute();
+            eager_LDA();
+            break;
+        
+        case 0xae:
+            eager_Absolute();
+            eager_LDX();
+            break;
+        
+        case 0xb0:
+            eager_Relative();
+            eager_BCS();
+            break;
+        
+        case 0xb1:
+            eager_IndirectY();
+            eager_LDA();
+            eager_Delay(eager_y);
+            break;
+        
+        case 0xb4:
+            eager_ZeroPageX();
+            eager_LDY();
+            break;
+        
+        case 0xb5:
+            eager_ZeroPageX();
+            eager_LDA();
+            break;
+        
+        case 0xb6:
+            eager_ZeroPageY();
+            eager_LDX();
+            break;
+        
+        case 0xb8:
+            eager_CLV();
+            break;
+        
+        case 0xb9:
+            eager_AbsoluteY();
+            eager_LDA();
+            eager_Delay(eager_y);
+            break;
+        
+        case 0xba:
+            eager_TSX();
+            break;
+        
+        case 0xbc:
+            eager_AbsoluteX();
+            eager_LDY();
+            eager_Delay(eager_x);
+            break;
+        
+        case 0xbd:
+            eager_AbsoluteX();
+            eager_LDA();
+            eager_Delay(eager_x);
+            break;
+        
+        case 0xbe:
+            eager_AbsoluteY();
+            eager_LDX();
+            eager_Delay(eager_y);
+            break;
+        
+        case 0xc0:
+            eager_Immediate();
+            eager_CPY();
+            break;
+        
+        case 0xc1:
+            eager_IndirectX();
+            eager_CMP();
+            break;
+        
+        case 0xc4:
+            eager_ZeroPage();
+            eager_CPY();
+            break;
+        
+        case 0xc5:
+            eager_ZeroPage();
+            eager_CMP();
+            break;
+        
+        case 0xc6:
+            eager_ZeroPage();
+            eager_DEC();
+            break;
+        
+        case 0xc8:
+            eager_INY();
+            break;
+        
+        case 0xc9:
+            eager_Immediate();
+            eager_CMP();
+            break;
+        
+        case 0xca:
+            eager_DEX();
+            break;
+        
+        case 0xcc:
+            eager_Absolute();
+            eager_CPY();
+            break;
+        
+        case 0xcd:
+            eager_Absolute();
+            eager_CMP();
+            break;
+        
+        case 0xce:
+            eager_Absolute();
+            eager_DEC();
+            break;
+        
+        case 0xd0:
+            eager_Relative();
+            eager_BNE();
+            break;
+        
+        case 0xd1:
+            eager_IndirectY();
+            eager_CMP();
+            eager_Delay(eager_y);
+            break;
+        
+        case 0xd5:
+            eager_ZeroPageX();
+            eager_CMP();
+            break;
+        
+        case 0xd6:
+            eager_ZeroPageX();
+            eager_DEC();
+            break;
+        
+        case 0xd8:
+            eager_CLD();
+            break;
+        
+        case 0xd9:
+            eager_AbsoluteY();
+            eager_CMP();
+            eager_Delay(eager_y);
+            break;
+        
+        case 0xdd:
+            eager_AbsoluteX();
+            eager_CMP();
+            eager_Delay(eager_x);
+            break;
+        
+        case 0xde:
+            eager_AbsoluteX();
+            eager_DEC();
+            break;
+        
+        case 0xe0:
+            eager_Immediate();
+            eager_CPX();
+            break;
+        
+        case 0xe1:
+            eager_IndirectX();
+            eager_SBC();
+            break;
+        
+        case 0xe4:
+            eager_ZeroPage();
+            eager_CPX();
+            break;
+        
+        case 0xe5:
+            eager_ZeroPage();
+            eager_SBC();
+            break;
+        
+        case 0xe6:
+            eager_ZeroPage();
+            eager_INC();
+            break;
+        
+        case 0xe8:
+            eager_INX();
+            break;
+        
+        case 0xe9:
+            eager_Immediate();
+            eager_SBC();
+            break;
+        
+        case 0xea:
+            eager_NOP();
+            break;
+        
+        case 0xec:
+            eager_Absolute();
+            eager_CPX();
+            break;
+        
+        case 0xed:
+            eager_Absolute();
+            eager_SBC();
+            break;
+        
+        case 0xee:
+            eager_Absolute();
+            eager_INC();
+            break;
+        
+        case 0xf0:
+            eager_Relative();
+            eager_BEQ();
+            break;
+        
+        case 0xf1:
+            eager_IndirectY();
+            eager_SBC();
+            eager_Delay(eager_y);
+            break;
+        
+        case 0xf5:
+            eager_ZeroPageX();
+            eager_SBC();
+            break;
+        
+        case 0xf6:
+            eager_ZeroPageX();
+            eager_INC();
+            break;
+        
+        case 0xf8:
+            eager_SED();
+            break;
+        
+        case 0xf9:
+            eager_AbsoluteY();
+            eager_SBC();
+            eager_Delay(eager_y);
+            break;
+        
+        case 0xfd:
+            eager_AbsoluteX();
+            eager_SBC();
+            eager_Delay(eager_x);
+            break;
+        
+        case 0xfe:
+            eager_AbsoluteX();
+            eager_INC();
+            break;
+        
+        default:
+            break;
+    }
+    
+    return eager_cycles;
+}
+
+uint32_t eager_ExecuteRES(void) {
+    eager_p = EAGER_FLAG.I | EAGER_FLAG.R | EAGER_FLAG.Z;
+    eager_pc.b.l = eager_memory[EAGER_RES.L];
+    eager_pc.b.h = eager_memory[EAGER_RES.H];
+    return 6;
+}
+
+uint32_t eager_ExecuteNMI(void) {
+    eager_Push(eager_pc.b.h);
+    eager_Push(eager_pc.b.l);
+    eager_p &= ~EAGER_FLAG.B;
+    eager_Push(eager_p);
+    eager_p |= EAGER_FLAG.I;
+    eager_pc.b.l = eager_memory[EAGER_NMI.L];
+    eager_pc.b.h = eager_memory[EAGER_NMI.H];
+    return 7;
+}
+
+uint32_t eager_ExecuteIRQ(void) {
+    if (!(eager_p & EAGER_FLAG.I)) {
+        eager_Push(eager_pc.b.h);
+        eager_Push(eager_pc.b.l);
+        eager_p &= ~EAGER_FLAG.B;
+        eager_Push(eager_p);
+        eager_p |= EAGER_FLAG.I;
+        eager_pc.b.l = eager_memory[EAGER_IRQ.L];
+        eager_pc.b.h = eager_memory[EAGER_IRQ.H];
+    }
+    return 7;
+}
@@ -0,0 +1,47 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _      __  ___
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /      / / _
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /   ___/ /__/
+//
+// ----------------------------------------------------------------------------
+// Copyright 2005 Greg Stanton
+// Copyright 2020 Rupert Carmichael
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// ----------------------------------------------------------------------------
+// SallyEager.h
+// ----------------------------------------------------------------------------
+#ifndef SALLY_EAGER_H
+#define SALLY_EAGER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "Pair.h"
+
+extern void eager_Reset(void);
+extern uint32_t eager_ExecuteInstruction(void);
+extern uint32_t eager_ExecuteRES(void);
+extern uint32_t eager_ExecuteNMI(void);
+extern uint32_t eager_ExecuteIRQ(void);
+extern uint8_t eager_memory[65536];
+extern uint8_t eager_a;
+extern uint8_t eager_x;
+extern uint8_t eager_y;
+extern uint8_t eager_p;
+extern uint8_t eager_s;
+extern pair eager_pc;
+
+#endif
@@ -0,0 +1,259 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _      __  ___
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /      / / _
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /   ___/ /__/
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// ----------------------------------------------------------------------------
+// SallyFlags.c
+// ----------------------------------------------------------------------------
+// Runs every opcode over every accumulator and operand value, under a spread
+// of starting status bytes, through both Sally and the eager reference core,
+// and checks they end with the same registers, status and memory. Sally
+// keeps N and Z as the last values they were taken from, so this covers
+// sally_Flags, sally_GetStatus and sally_SetStatus on every path that sets
+// them, decimal ADC and SBC and BIT included.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "ProSystem.h"
+#include "SallyEager.h"
+
+// Where operands are placed: the instruction at CODE, a zero page operand
+// or pointer at DIRECT, an absolute operand or pointer target at TARGET
+#define CODE 0x1800
+#define DIRECT 0x80
+#define TARGET 0x1980
+#define STACK 0xf0
+#define INDEX 4
+
+typedef enum {
+    MODE_IMPLIED,
+    MODE_IMMEDIATE,
+    MODE_ZERO_PAGE,
+    MODE_ZERO_PAGE_X,
+    MODE_ZERO_PAGE_Y,
+    MODE_ABSOLUTE,
+    MODE_ABSOLUTE_X,
+    MODE_ABSOLUTE_Y,
+    MODE_INDIRECT_X,
+    MODE_INDIRECT_Y,
+    MODE_INDIRECT,
+    MODE_RELATIVE
+} mode;
+
+// Starting status bytes: each combination of carry and decimal, with the
+// other flags both clear and set
+static const uint8_t STATUS[] = {0x20, 0x21, 0x28, 0x29, 0x30, 0xe3, 0xea, 0xff};
+
+static mode flags_GetMode(uint8_t opcode) {
+    static const mode GROUP0[8] = {MODE_IMMEDIATE, MODE_ZERO_PAGE, MODE_IMPLIED, MODE_ABSOLUTE, MODE_RELATIVE, MODE_ZERO_PAGE_X, MODE_IMPLIED, MODE_ABSOLUTE_X};
+    static const mode GROUP1[8] = {MODE_INDIRECT_X, MODE_ZERO_PAGE, MODE_IMMEDIATE, MODE_ABSOLUTE, MODE_INDIRECT_Y, MODE_ZERO_PAGE_X, MODE_ABSOLUTE_Y, MODE_ABSOLUTE_X};
+    static const mode GROUP2[8] = {MODE_IMMEDIATE, MODE_ZERO_PAGE, MODE_IMPLIED, MODE_ABSOLUTE, MODE_IMPLIED, MODE_ZERO_PAGE_X, MODE_IMPLIED, MODE_ABSOLUTE_X};
+    
+    switch (opcode) {
+        case 0x00: case 0x40: case 0x60:
+            return MODE_IMPLIED;
+        case 0x20: case 0x4c:
+            return MODE_ABSOLUTE;
+        case 0x6c:
+            return MODE_INDIRECT;
+        case 0x96: case 0xb6:
+            return MODE_ZERO_PAGE_Y;
+        case 0xbe:
+            return MODE_ABSOLUTE_Y;
+        case 0x0b: case 0x2b: case 0x4b:
+            return MODE_IMMEDIATE;
+    }
+    
+    switch (opcode & 3) {
+        case 0: return GROUP0[(opcode >> 2) & 7];
+        case 1: return GROUP1[(opcode >> 2) & 7];
+        case 2: return GROUP2[(opcode >> 2) & 7];
+    }
+    return MODE_IMPLIED;
+}
+
+// Writes a byte where both cores will read it
+static void flags_Poke(uint16_t address, uint8_t data) {
+    memory_Write(address, data);
+    eager_memory[address] = data;
+}
+
+// Places the instruction and its operand value, and returns the address
+// the operand is read from or written to, or 0 if it has none
+static uint16_t flags_Place(uint8_t opcode, uint8_t value, uint8_t x, uint8_t y) {
+    uint16_t address = 0;
+    
+    flags_Poke(CODE, opcode);
+    flags_Poke(CODE + 1, DIRECT);
+    flags_Poke(CODE + 2, TARGET >> 8);
+    
+    switch (flags_GetMode(opcode)) {
+        case MODE_IMMEDIATE:
+        case MODE_RELATIVE:
+            flags_Poke(CODE + 1, value);
+            break;
+        
+        case MODE_ZERO_PAGE:
+            address = DIRECT;
+            break;
+        
+        case MODE_ZERO_PAGE_X:
+            address = (DIRECT + x) & 0xff;
+            break;
+        
+        case MODE_ZERO_PAGE_Y:
+            address = (DIRECT + y) & 0xff;
+            break;
+        
+        case MODE_ABSOLUTE:
+        case MODE_INDIRECT:
+            flags_Poke(CODE + 1, TARGET & 0xff);
+            address = TARGET;
+            break;
+        
+        case MODE_ABSOLUTE_X:
+            flags_Poke(CODE + 1, TARGET & 0xff);
+            address = TARGET + x;
+            break;
+        
+        case MODE_ABSOLUTE_Y:
+            flags_Poke(CODE + 1, TARGET & 0xff);
+            address = TARGET + y;
+            break;
+        
+        case MODE_INDIRECT_X:
+            flags_Poke((DIRECT + x) & 0xff, TARGET & 0xff);
+            flags_Poke((DIRECT + x + 1) & 0xff, TARGET >> 8);
+            address = TARGET;
+            break;
+        
+        case MODE_INDIRECT_Y:
+            flags_Poke(DIRECT, TARGET & 0xff);
+            flags_Poke(DIRECT + 1, TARGET >> 8);
+            address = TARGET + y;
+            break;
+        
+        default:
+            break;
+    }
+    
+    if (address != 0) {
+        flags_Poke(address, value);
+        flags_Poke(address + 1, value ^ 0xa5);
+    }
+    
+    // What PLA, PLP, RTS and RTI pull
+    flags_Poke(0x100 + STACK + 1, value);
+    flags_Poke(0x100 + STACK + 2, value ^ 0x5a);
+    flags_Poke(0x100 + STACK + 3, value + 0x33);
+    return address;
+}
+
+static bool flags_Check(uint8_t opcode, uint8_t a, uint8_t value, uint8_t status) {
+    uint8_t x = INDEX;
+    uint8_t y = INDEX;
+    uint8_t s = STACK;
+    
+    // Instructions that take X, Y or S as data sweep it instead
+    switch (opcode) {
+        case 0xe0: case 0xe4: case 0xec: case 0xe8: case 0xca:
+        case 0x8a: case 0x9a: case 0x86: case 0x8e: case 0x96:
+            x = a;
+            break;
+        
+        case 0xc0: case 0xc4: case 0xcc: case 0xc8: case 0x88:
+        case 0x98: case 0x84: case 0x8c: case 0x94:
+            y = a;
+            break;
+        
+        case 0xba:
+            s = a;
+            break;
+    }
+    
+    uint16_t address = flags_Place(opcode, value, x, y);
+    
+    sally_a = eager_a = a;
+    sally_x = eager_x = x;
+    sally_y = eager_y = y;
+    sally_s = eager_s = s;
+    sally_pc.w = eager_pc.w = CODE;
+    sally_SetStatus(status);
+    eager_p = status;
+    
+    sally_ExecuteInstruction();
+    eager_ExecuteInstruction();
+    
+    bool same = sally_GetStatus() == eager_p && sally_a == eager_a && sally_x == eager_x &&
+        sally_y == eager_y && sally_s == eager_s && sally_pc.w == eager_pc.w;
+    if (address != 0) {
+        same = same && memory_Read(address) == eager_memory[address];
+    }
+    for (int index = 0x100 + STACK - 8; index <= 0x100 + STACK; index++) {
+        same = same && memory_Read(index) == eager_memory[index];
+    }
+    
+    if (!same) {
+        printf("opcode %02x a %02x value %02x status %02x: P %02x/%02x A %02x/%02x X %02x/%02x Y %02x/%02x S %02x/%02x PC %04x/%04x\n",
+            opcode, a, value, status, sally_GetStatus(), eager_p, sally_a, eager_a, sally_x, eager_x,
+            sally_y, eager_y, sally_s, eager_s, sally_pc.w, eager_pc.w);
+    }
+    return same;
+}
+
+int main(void) {
+    // An empty 32K cartridge, for the interrupt vectors
+    static uint8_t rom[0x8000];
+    rom[0x7ffa] = 0x00;
+    rom[0x7ffb] = 0x1a;
+    rom[0x7ffc] = 0x00;
+    rom[0x7ffd] = 0x80;
+    rom[0x7ffe] = 0x40;
+    rom[0x7fff] = 0x1a;
+    memcpy(eager_memory + 0x8000, rom, sizeof(rom));
+    
+    database_enabled = false;
+    if (!cartridge_Load(rom, sizeof(rom))) {
+        printf("FAIL: cartridge_Load\n");
+        return 1;
+    }
+    prosystem_Reset();
+    
+    uint32_t failures = 0;
+    uint32_t checks = 0;
+    for (int opcode = 0; opcode < 256; opcode++) {
+        uint32_t before = failures;
+        for (int status = 0; status < (int)sizeof(STATUS); status++) {
+            for (int a = 0; a < 256; a++) {
+                for (int value = 0; value < 256; value++) {
+                    failures += !flags_Check(opcode, a, value, STATUS[status]);
+                    checks++;
+                    if (failures - before >= 4) {
+                        goto next;
+                    }
+                }
+            }
+        }
+    next:;
+    }
+    
+    printf("%s: %u checks, %u failures\n", failures? "FAIL": "ok", checks, failures);
+    return failures? 1: 0;
+}
@@ -0,0 +1,297 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _      __  ___
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /      / / _
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /   ___/ /__/
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// SallyIdle.c
+// ----------------------------------------------------------------------------
+// Runs programs that wait on the timer and on MSTAT, once with sally_Idle
+// crediting the passes of their wait loops and once running every pass, and
+// checks that each frame ends at the same cycle with the same registers
+// and memory. One program has short loops that look like wait loops but
+// change memory or registers on every pass, which must not be skipped.
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ProSystem.h"
+#include "TestRom.h"
+
+#define FRAMES 120
+#define DLL 0xe000
+#define DL 0xe100
+
+// Counters the programs keep in RAM
+#define LOOPS 0x1800
+#define NMIS 0x1802
+#define SPINS 0x1803
+
+typedef struct {
+    uint32_t clock;
+    uint32_t cycles;
+    uint8_t a, x, y, p, s;
+    uint16_t pc;
+    uint64_t ram;
+} idle_frame;
+
+// What the DLI handler does besides counting
+typedef enum {
+    HANDLER_KEEP,
+    HANDLER_CLOBBER,
+    HANDLER_TIMER
+} idle_handler;
+
+typedef struct {
+    const char* name;
+    uint16_t (*build)(void);
+    idle_handler handler;
+} idle_program;
+
+// Eighteen empty zones of sixteen lines, with a DLI on every third
+static void idle_Display(void) {
+    for (int zone = 0; zone < 18; zone++) {
+        const uint8_t entry[3] = {(zone % 3? 0x00: 0x80) | 15, DL >> 8, DL & 0xff};
+        rom_Put(DLL + zone * 3, entry, sizeof(entry));
+    }
+}
+
+// Counts the wait loops done in LOOPS, and jumps back to loop
+static void idle_Count(uint16_t loop) {
+    ROM_EMIT(0xee, LOOPS & 0xff, LOOPS >> 8);
+    uint16_t carry = rom_Forward(0xd0);
+    ROM_EMIT(0xee, (LOOPS + 1) & 0xff, (LOOPS + 1) >> 8);
+    rom_Land(carry);
+    ROM_EMIT(0x4c, loop & 0xff, loop >> 8);
+}
+
+// An NMI handler that counts the DLIs. It either leaves A and the flags as
+// they were, returns with A = $80 and N set, or also restarts the timer.
+static uint16_t idle_Handler(idle_handler handler) {
+    uint16_t nmi = rom_Here();
+    switch (handler) {
+        case HANDLER_KEEP:
+            ROM_EMIT(0x48, 0xee, NMIS & 0xff, NMIS >> 8, 0x68, 0x40);
+            break;
+        
+        case HANDLER_CLOBBER:
+            ROM_EMIT(0xee, NMIS & 0xff, NMIS >> 8, 0xa9, 0x80, 0x40);
+            break;
+        
+        case HANDLER_TIMER:
+            ROM_EMIT(0x48, 0xee, NMIS & 0xff, NMIS >> 8, 0xa9, 4, 0x8d, TIM64T & 0xff, TIM64T >> 8, 0x68, 0x40);
+            break;
+    }
+    return nmi;
+}
+
+// LDA INTIM / BNE after TIM8T
+static uint16_t idle_BuildIntim(void) {
+    uint16_t reset = rom_Here();
+    rom_Start(DLL, 0x40);
+    uint16_t loop = rom_Here();
+    ROM_EMIT(0xa9, 20, 0x8d, TIM8T & 0xff, TIM8T >> 8);
+    uint16_t wait = rom_Here();
+    ROM_EMIT(0xad, INTIM & 0xff, INTIM >> 8);
+    rom_Branch(0xd0, wait);
+    idle_Count(loop);
+    return reset;
+}
+
+// BIT INTFLG / BPL after TIM64T, with DMA off
+static uint16_t idle_BuildIntflg(void) {
+    uint16_t reset = rom_Here();
+    rom_Start(DLL, 0x60);
+    uint16_t loop = rom_Here();
+    ROM_EMIT(0xa9, 3, 0x8d, TIM64T & 0xff, TIM64T >> 8);
+    uint16_t wait = rom_Here();
+    ROM_EMIT(0x2c, INTFLG & 0xff, INTFLG >> 8);
+    rom_Branch(0x10, wait);
+    idle_Count(loop);
+    return reset;
+}
+
+// BIT INTIM / BVS and LDX INTIM / BMI, which wait through ticks of the
+// timer that do not end a run
+static uint16_t idle_BuildTicks(void) {
+    uint16_t reset = rom_Here();
+    rom_Start(DLL, 0x40);
+    uint16_t loop = rom_Here();
+    ROM_EMIT(0xa9, 0x50, 0x8d, TIM8T & 0xff, TIM8T >> 8);
+    uint16_t wait = rom_Here();
+    ROM_EMIT(0x2c, INTIM & 0xff, INTIM >> 8);
+    rom_Branch(0x70, wait);
+    ROM_EMIT(0xa9, 0xc0, 0x8d, TIM64T & 0xff, TIM64T >> 8);
+    wait = rom_Here();
+    ROM_EMIT(0xae, INTIM & 0xff, INTIM >> 8);
+    rom_Branch(0x30, wait);
+    idle_Count(loop);
+    return reset;
+}
+
+// BIT INTFLG / BVC, which never ends, while the DLI handler restarts the
+// timer: each time it runs out the next read has to clear INTFLG
+static uint16_t idle_BuildExpire(void) {
+    uint16_t reset = rom_Here();
+    rom_Start(DLL, 0x40);
+    uint16_t wait = rom_Here();
+    ROM_EMIT(0x2c, INTFLG & 0xff, INTFLG >> 8);
+    rom_Branch(0x50, wait);
+    return reset;
+}
+
+// LDY INTIM / BNE, with a DLI handler that leaves A and the flags changed
+// whenever it interrupts the loop
+static uint16_t idle_BuildClobber(void) {
+    uint16_t reset = rom_Here();
+    rom_Start(DLL, 0x40);
+    uint16_t loop = rom_Here();
+    ROM_EMIT(0xa9, 90, 0x8d, TIM8T & 0xff, TIM8T >> 8);
+    uint16_t wait = rom_Here();
+    ROM_EMIT(0xac, INTIM & 0xff, INTIM >> 8);
+    rom_Branch(0xd0, wait);
+    idle_Count(loop);
+    return reset;
+}
+
+// BIT MSTAT / BPL into vertical blank, then LDX MSTAT / BMI out of it
+static uint16_t idle_BuildMstat(void) {
+    uint16_t reset = rom_Here();
+    rom_Start(DLL, 0x40);
+    uint16_t loop = rom_Here();
+    uint16_t wait = rom_Here();
+    ROM_EMIT(0x24, MSTAT);
+    rom_Branch(0x10, wait);
+    wait = rom_Here();
+    ROM_EMIT(0xae, MSTAT, 0x00);
+    rom_Branch(0x30, wait);
+    idle_Count(loop);
+    return reset;
+}
+
+// JMP onto itself, with the work done in the DLI handler
+static uint16_t idle_BuildJump(void) {
+    uint16_t reset = rom_Here();
+    rom_Start(DLL, 0x40);
+    uint16_t wait = rom_Here();
+    ROM_EMIT(0x4c, wait & 0xff, wait >> 8);
+    return reset;
+}
+
+// Loops as short as a wait loop that change memory or X on every pass
+static uint16_t idle_BuildBusy(void) {
+    uint16_t reset = rom_Here();
+    rom_Start(DLL, 0x40);
+    uint16_t loop = rom_Here();
+    uint16_t spin = rom_Here();
+    ROM_EMIT(0xee, SPINS & 0xff, SPINS >> 8);
+    rom_Branch(0xd0, spin);
+    spin = rom_Here();
+    ROM_EMIT(0xca);
+    rom_Branch(0xd0, spin);
+    spin = rom_Here();
+    ROM_EMIT(0xe6, 0x80);
+    rom_Branch(0x10, spin);
+    idle_Count(loop);
+    return reset;
+}
+
+static const idle_program IDLE_PROGRAMS[] = {
+    {"intim", idle_BuildIntim, HANDLER_KEEP},
+    {"intflg", idle_BuildIntflg, HANDLER_KEEP},
+    {"ticks", idle_BuildTicks, HANDLER_KEEP},
+    {"expire", idle_BuildExpire, HANDLER_TIMER},
+    {"clobber", idle_BuildClobber, HANDLER_CLOBBER},
+    {"mstat", idle_BuildMstat, HANDLER_KEEP},
+    {"jump", idle_BuildJump, HANDLER_KEEP},
+    {"busy", idle_BuildBusy, HANDLER_KEEP}
+};
+
+static uint64_t idle_Hash(const uint8_t* data, uint32_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (uint32_t index = 0; index < size; index++) {
+        hash = (hash ^ data[index]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool idle_Same(const idle_frame* a, const idle_frame* b) {
+    return a->clock == b->clock && a->cycles == b->cycles && a->a == b->a && a->x == b->x && a->y == b->y &&
+        a->p == b->p && a->s == b->s && a->pc == b->pc && a->ram == b->ram;
+}
+
+static bool idle_Run(const idle_program* program, bool busy, idle_frame* frames) {
+    rom_Begin();
+    uint16_t reset = program->build();
+    idle_Display();
+    uint16_t nmi = idle_Handler(program->handler);
+    if (!rom_Load(nmi, reset, nmi)) {
+        return false;
+    }
+    sally_SetBusyWait(busy);
+    
+    // The clock is not reset with the machine
+    uint32_t start = prosystem_clock;
+    const uint8_t input[17] = {0};
+    for (int frame = 0; frame < FRAMES; frame++) {
+        prosystem_ExecuteFrame(input);
+        idle_frame* state = &frames[frame];
+        state->clock = prosystem_clock - start;
+        state->cycles = prosystem_cycles;
+        state->a = sally_a;
+        state->x = sally_x;
+        state->y = sally_y;
+        state->p = sally_GetStatus();
+        state->s = sally_s;
+        state->pc = sally_pc.w;
+        state->ram = idle_Hash(memory_ram, MEMORY_SIZE);
+    }
+    sally_SetBusyWait(false);
+    return true;
+}
+
+int main(void) {
+    static idle_frame skipped[FRAMES];
+    static idle_frame run[FRAMES];
+    uint32_t failures = 0;
+    
+    for (int index = 0; index < (int)(sizeof(IDLE_PROGRAMS) / sizeof(IDLE_PROGRAMS[0])); index++) {
+        const idle_program* program = &IDLE_PROGRAMS[index];
+        if (!idle_Run(program, false, skipped) || !idle_Run(program, true, run)) {
+            return 1;
+        }
+        
+        int frame = 0;
+        while (frame < FRAMES && idle_Same(&skipped[frame], &run[frame])) {
+            frame++;
+        }
+        if (frame < FRAMES) {
+            const idle_frame* a = &skipped[frame];
+            const idle_frame* b = &run[frame];
+            printf("%s: frame %d: clock %u/%u cycles %u/%u A %02x/%02x X %02x/%02x Y %02x/%02x P %02x/%02x S %02x/%02x PC %04x/%04x RAM %s\n",
+                program->name, frame, a->clock, b->clock, a->cycles, b->cycles, a->a, b->a, a->x, b->x, a->y, b->y,
+                a->p, b->p, a->s, b->s, a->pc, b->pc, a->ram == b->ram? "same": "differs");
+            failures++;
+        }
+        else if (memory_ram[LOOPS] == 0 && memory_ram[LOOPS + 1] == 0 && memory_ram[NMIS] == 0) {
+            printf("%s: never got past its first wait\n", program->name);
+            failures++;
+        }
+    }
+    
+    printf("%s: %u programs, %u failures\n", failures? "FAIL": "ok", (uint32_t)(sizeof(IDLE_PROGRAMS) / sizeof(IDLE_PROGRAMS[0])), failures);
+    return failures? 1: 0;
+}
@@ -0,0 +1,89 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _      __  ___
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /      / / _
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /   ___/ /__/
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// TestRom.c
+// ----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "ProSystem.h"
+#include "TestRom.h"
+
+static uint8_t rom_data[ROM_SIZE];
+static uint16_t rom_pc;
+
+void rom_Begin(void) {
+    memset(rom_data, 0, sizeof(rom_data));
+    rom_pc = ROM_BASE;
+}
+
+uint16_t rom_Here(void) {
+    return rom_pc;
+}
+
+void rom_Emit(const uint8_t* data, uint32_t size) {
+    rom_Put(rom_pc, data, size);
+    rom_pc += size;
+}
+
+// Places data anywhere in the cartridge, for display lists and graphics
+void rom_Put(uint16_t address, const uint8_t* data, uint32_t size) {
+    memcpy(rom_data + (address - ROM_BASE), data, size);
+}
+
+// A branch back to an address already emitted
+void rom_Branch(uint8_t opcode, uint16_t target) {
+    ROM_EMIT(opcode, (uint8_t)(target - (rom_pc + 2)));
+}
+
+// A branch ahead, to where rom_Land is later called with what this returns
+uint16_t rom_Forward(uint8_t opcode) {
+    ROM_EMIT(opcode, 0);
+    return rom_pc - 2;
+}
+
+void rom_Land(uint16_t branch) {
+    rom_data[branch + 1 - ROM_BASE] = (uint8_t)(rom_pc - (branch + 2));
+}
+
+// What every program starts with: interrupts off, binary mode, the stack
+// at the top of page one, the console locked into 7800 mode, and Maria
+// pointed at the display list list at dpp
+void rom_Start(uint16_t dpp, uint8_t ctrl) {
+    ROM_EMIT(0x78, 0xd8, 0xa2, 0xff, 0x9a);
+    ROM_EMIT(0xa9, 0x07, 0x85, INPTCTRL);
+    ROM_EMIT(0xa9, dpp >> 8, 0x85, DPPH, 0xa9, dpp & 0xff, 0x85, DPPL);
+    ROM_EMIT(0xa9, ctrl, 0x85, CTRL);
+}
+
+// Fills in the vectors, then loads and resets the cartridge
+bool rom_Load(uint16_t nmi, uint16_t reset, uint16_t irq) {
+    const uint8_t vectors[6] = {nmi & 0xff, nmi >> 8, reset & 0xff, reset >> 8, irq & 0xff, irq >> 8};
+    rom_Put(0xfffa, vectors, sizeof(vectors));
+    
+    database_enabled = false;
+    if (!cartridge_Load(rom_data, sizeof(rom_data))) {
+        printf("FAIL: cartridge_Load\n");
+        return false;
+    }
+    prosystem_Reset();
+    return true;
+}
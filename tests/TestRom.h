@@ -0,0 +1,45 @@
+// ----------------------------------------------------------------------------
+//   ___  ___  ___  ___       ___  ____  ___  _  _      __  ___
+//  /__/ /__/ /  / /__  /__/ /__    /   /_   / |/ /      / / _
+// /    / \  /__/ ___/ ___/ ___/   /   /__  /    /   ___/ /__/
+//
+// ----------------------------------------------------------------------------
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+// TestRom.h
+// ----------------------------------------------------------------------------
+// Assembles small 32K test cartridges in memory, for the drivers here that
+// need a program running on the whole machine rather than one instruction.
+#ifndef TEST_ROM_H
+#define TEST_ROM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ROM_BASE 0x8000
+#define ROM_SIZE 0x8000
+
+#define ROM_EMIT(...) rom_Emit((const uint8_t[]){__VA_ARGS__}, sizeof((const uint8_t[]){__VA_ARGS__}))
+
+extern void rom_Begin(void);
+extern uint16_t rom_Here(void);
+extern void rom_Emit(const uint8_t* data, uint32_t size);
+extern void rom_Put(uint16_t address, const uint8_t* data, uint32_t size);
+extern void rom_Branch(uint8_t opcode, uint16_t target);
+extern uint16_t rom_Forward(uint8_t opcode);
+extern void rom_Land(uint16_t branch);
+extern void rom_Start(uint16_t dpp, uint8_t ctrl);
+extern bool rom_Load(uint16_t nmi, uint16_t reset, uint16_t irq);
+
+#endif